@@ -0,0 +1,126 @@
+/*
+ * Userspace microbenchmark for the minivosc fill engine.
+ * Build with "make fillbench", run ./fill-bench [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "genetlink-common.h"
+#include "minivosc-fill.h"
+
+#define BUFFER_BYTES (16 * DC_PCM_CHUNK_DATA_LEN)
+
+// what minivosc_fill_capture_buf() used to do, for comparison
+static void bytewise_copy(char *dst, unsigned int size, unsigned int *pos, const char *src, unsigned int len)
+{
+	unsigned int j;
+	for (j = 0; j < len; j++) {
+		dst[(*pos)++] = src[j];
+		if (*pos >= size)
+			*pos = 0;
+	}
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *name, double ns, unsigned long bytes)
+{
+	printf("%-24s %8.3f ns/byte %10.1f MB/s\n", name, ns / bytes, bytes / ns * 1e3);
+}
+
+int main(int argc, char *argv[])
+{
+	static char area[BUFFER_BYTES] __attribute__((aligned(4))), check[BUFFER_BYTES];
+	static char chunk[DC_PCM_CHUNK_DATA_LEN] __attribute__((aligned(4)));
+	const u8 silence[8] = { 0, 0x80, 0, 0x80, 0, 0x80, 0, 0x80 }; /* U16_LE */
+	unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 0) : 20000;
+	unsigned long i, bytes;
+	struct minivosc_dma dma;
+	unsigned int pos = 0, f;
+	double t;
+
+	for (i = 0; i < sizeof(chunk); i++)
+		chunk[i] = (char)(i * 7);
+
+	// sizes that are not a divisor of the buffer, so copies wrap
+	bytes = 0;
+	t = now_ns();
+	for (i = 0; i < iterations; i++) {
+		unsigned int len = sizeof(chunk) - (i % 7) * 2;
+		bytewise_copy(check, sizeof(check), &pos, chunk, len);
+		bytes += len;
+	}
+	report("bytewise copy", now_ns() - t, bytes);
+
+	minivosc_dma_init(&dma, area, sizeof(area), silence);
+	bytes = 0;
+	t = now_ns();
+	for (i = 0; i < iterations; i++) {
+		unsigned int len = sizeof(chunk) - (i % 7) * 2;
+		minivosc_dma_copy(&dma, chunk, len);
+		bytes += len;
+	}
+	report("minivosc_dma_copy", now_ns() - t, bytes);
+
+	if (dma.pos != pos || memcmp(area, check, sizeof(area))) {
+		fprintf(stderr, "mismatch: engine pos=%u, bytewise pos=%u\n", dma.pos, pos);
+		return 1;
+	}
+
+	bytes = 0;
+	t = now_ns();
+	for (i = 0; i < iterations; i++) {
+		minivosc_dma_silence(&dma, DC_PCM_CHUNK_DATA_LEN);
+		bytes += DC_PCM_CHUNK_DATA_LEN;
+	}
+	report("minivosc_dma_silence", now_ns() - t, bytes);
+
+	for (i = 0; i < sizeof(area); i += 2) {
+		if ((u8)area[i] != 0 || (u8)area[i + 1] != 0x80) {
+			fprintf(stderr, "bad silence at %lu\n", i);
+			return 1;
+		}
+	}
+
+	// format conversion of one chunk, checked against the obvious per-sample code
+	for (f = 0; f < 6; f++) {
+		static const char *names[6] = {
+			"convert s16 mono", "convert s16 stereo", "convert u16 mono",
+			"convert u16 stereo", "convert s32 mono", "convert s32 stereo" };
+		enum minivosc_fmt fmt = (enum minivosc_fmt)(f / 2);
+		unsigned int ch = f % 2 + 1, frames = sizeof(chunk) / 2;
+		unsigned int fb = minivosc_convert_frame_bytes(fmt, ch);
+		const int16_t *in = (const int16_t *)chunk;
+
+		bytes = 0;
+		t = now_ns();
+		for (i = 0; i < iterations; i++) {
+			minivosc_convert(area, in, frames, fmt, ch);
+			bytes += frames * fb;
+		}
+		report(names[f], now_ns() - t, bytes);
+
+		for (i = 0; i < frames * ch; i++) {
+			int32_t want = in[i / ch], got;
+			if (fmt == MINIVOSC_FMT_S32)
+				got = ((int32_t *)area)[i] >> 16;
+			else if (fmt == MINIVOSC_FMT_U16)
+				got = (int32_t)((uint16_t *)area)[i] - 0x8000;
+			else
+				got = ((int16_t *)area)[i];
+			if (got != want) {
+				fprintf(stderr, "%s: bad sample %lu (%d != %d)\n", names[f], i, got, want);
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Netlink handler throughput versus number of concurrent senders.
+ * Each sender thread has its own socket and waits for the kernel's ACK of
+ * every message, so the rate measured is the rate the handler completes.
+ *
+ * Usage: ./genetlink-bench [max-senders] [seconds-per-step] [cards]
+ * Needs the driver loaded; create several cards (enable=1,1,..) to spread
+ * senders over separate jitter buffers.
+ */
+#include <netlink/netlink.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/genl/genl.h>
+#include <netlink/genl/family.h>
+#include <linux/genetlink.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "genetlink-common.h"
+
+#define errprint(...) fprintf(stderr, __VA_ARGS__)
+
+#define FRAME_SAMPLES 160 /* 10ms */
+
+struct sender_s {
+	pthread_t thread;
+	unsigned card;
+	volatile int *stop;
+	unsigned long sent;
+	int error;
+};
+
+static double now_sec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *sender_main(void *arg)
+{
+	struct sender_s *s = arg;
+	struct nl_sock *sock;
+	struct nl_msg *msg;
+	int family_id, rc;
+	unsigned sequence = 0;
+	char frame[FRAME_SAMPLES * DC_PCM_SAMPLE_BYTES];
+
+	memset(frame, 0, sizeof(frame));
+
+	sock = nl_socket_alloc();
+	if (!sock || genl_connect(sock)) {
+		errprint("genl_connect failed\n");
+		s->error = 1;
+		goto EARLY_OUT;
+	}
+	if ((family_id = genl_ctrl_resolve(sock, DC_GENL_FAMILY_NAME)) < 0) {
+		errprint("Unable to resolve family name: %s\n", nl_geterror(family_id));
+		s->error = 1;
+		goto EARLY_OUT;
+	}
+
+	while (!*s->stop) {
+		msg = nlmsg_alloc();
+		if (!msg) {
+			s->error = 1;
+			break;
+		}
+		sequence++;
+		if (!genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ, family_id, 0, 0, DC_GENL_CMD_PCM, DC_GENL_VERSION) ||
+		    nla_put_u32(msg, DC_GENL_ATTR_CARD, s->card) < 0 ||
+		    nla_put_u32(msg, DC_GENL_ATTR_PCM_SEQUENCE, sequence) < 0 ||
+		    nla_put_u32(msg, DC_GENL_ATTR_PCM_SAMPLES, FRAME_SAMPLES) < 0 ||
+		    nla_put(msg, DC_GENL_ATTR_PCM_DATA, sizeof(frame), frame) < 0) {
+			nlmsg_free(msg);
+			s->error = 1;
+			break;
+		}
+
+		// frees msg, returns once the handler has run
+		if ((rc = nl_send_sync(sock, msg)) < 0) {
+			errprint("nl_send_sync: %s\n", nl_geterror(rc));
+			s->error = 1;
+			break;
+		}
+		s->sent++;
+	}
+
+EARLY_OUT:
+	if (sock) nl_socket_free(sock);
+	return NULL;
+}
+
+static int run_step(int senders, double seconds, unsigned cards)
+{
+	struct sender_s *s = calloc(senders, sizeof(*s));
+	volatile int stop = 0;
+	unsigned long total = 0;
+	double t0, t1;
+	int i, error = 0;
+
+	if (!s)
+		return -1;
+
+	t0 = now_sec();
+	for (i = 0; i < senders; i++) {
+		s[i].card = i % cards;
+		s[i].stop = &stop;
+		pthread_create(&s[i].thread, NULL, sender_main, &s[i]);
+	}
+
+	while (now_sec() - t0 < seconds)
+		usleep(10000);
+	stop = 1;
+
+	for (i = 0; i < senders; i++) {
+		pthread_join(s[i].thread, NULL);
+		total += s[i].sent;
+		error |= s[i].error;
+	}
+	t1 = now_sec();
+
+	printf("%7d %12.0f %10.2f %14.0f\n", senders, total / (t1 - t0),
+	       total * FRAME_SAMPLES * DC_PCM_SAMPLE_BYTES / (t1 - t0) / 1e6,
+	       total / (t1 - t0) / senders);
+	free(s);
+	return error ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int max_senders = argc > 1 ? atoi(argv[1]) : 8;
+	double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+	unsigned cards = argc > 3 ? strtoul(argv[3], NULL, 0) : 1;
+	int n;
+
+	if (max_senders < 1 || seconds <= 0 || cards < 1) {
+		errprint("Usage: %s [max-senders] [seconds-per-step] [cards]\n", argv[0]);
+		return 1;
+	}
+
+	printf("senders        msg/s       MB/s  msg/s/sender\n");
+	for (n = 1; n <= max_senders; n *= 2) {
+		if (run_step(n, seconds, cards) < 0)
+			return 1;
+	}
+	return 0;
+}
@@ -1,10 +1,28 @@
+#define _GNU_SOURCE // sched_setaffinity
 #include <netlink/netlink.h>
 #include <netlink/genl/ctrl.h>
 #include <netlink/genl/genl.h>
 #include <netlink/genl/family.h>
 #include <linux/genetlink.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <math.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 
 #include "genetlink-common.h"
 
@@ -28,22 +46,1155 @@ struct unl_s {
 	int hdrlen;
 };
 
+// last DC_GENL_CMD_FEEDBACK for our card
+struct feedback_s {
+	unsigned card;
+	int valid;
+	unsigned fill, target, drops, underruns, lost, period_us;
+	int drift_ppm;
+};
+
+// capture time for DC_GENL_ATTR_PCM_TIMESTAMP, same clock as the driver's
+static unsigned long long monotonic_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Preallocated PCM message of the send path. The netlink, genetlink and
+ * attribute headers are built once; per frame only the sequence, timestamp
+ * and lengths are patched, and the samples go out from where they were read
+ * (iov[1]) through a plain AF_NETLINK socket. No allocation or copy per frame.
+ */
+#define PCM_MSG_HDR_MAX 64
+
+struct pcm_msg_s {
+	int fd;
+	char hdr[PCM_MSG_HDR_MAX] __attribute__((aligned(4)));
+	unsigned hdr_len;
+	struct nlmsghdr *nlh;
+	struct nlattr *data;	// header of the attribute holding the samples
+	__u32 *sequence;	// PCM_SEQUENCE, or dc_pcm_chunk_s.sequence
+	__u32 *samples;		// PCM_SAMPLES, NULL for fixed chunks
+	char *tstamp;		// PCM_TIMESTAMP, only 4 byte aligned
+	struct sockaddr_nl kernel;
+	struct iovec iov[3];	// headers, samples, attribute padding
+	struct msghdr mh;
+	unsigned long errors;
+};
+
+static int verbose;
+
+// appends an attribute header to m->hdr, returns where its payload goes
+static void *pcm_msg_attr(struct pcm_msg_s *m, int type, unsigned len)
+{
+	struct nlattr *nla = (struct nlattr *)(m->hdr + m->hdr_len);
+
+	nla->nla_type = type;
+	nla->nla_len = NLA_HDRLEN + len;
+	m->hdr_len += NLA_HDRLEN + NLA_ALIGN(len);
+	return (char *)nla + NLA_HDRLEN;
+}
+
+static int pcm_msg_init(struct pcm_msg_s *m, int family_id, int cmd, unsigned card)
+{
+	static const char pad[NLA_ALIGNTO];
+	struct sockaddr_nl local = { .nl_family = AF_NETLINK };
+	struct genlmsghdr *genl;
+
+	memset(m, 0, sizeof(*m));
+	m->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+	if (m->fd < 0) {
+		errprint("Unable to open netlink socket: %s\n", strerror(errno));
+		return -1;
+	}
+	// port id 0: the kernel picks one
+	if (bind(m->fd, (struct sockaddr *)&local, sizeof(local)) < 0) {
+		errprint("Unable to bind netlink socket: %s\n", strerror(errno));
+		close(m->fd);
+		m->fd = -1;
+		return -1;
+	}
+
+	m->nlh = (struct nlmsghdr *)m->hdr;
+	m->nlh->nlmsg_type = family_id;
+	// no NLM_F_ACK: the kernel only answers when it rejects a frame
+	m->nlh->nlmsg_flags = NLM_F_REQUEST;
+	genl = (struct genlmsghdr *)(m->hdr + NLMSG_HDRLEN);
+	genl->cmd = cmd;
+	genl->version = DC_GENL_VERSION;
+	m->hdr_len = NLMSG_HDRLEN + GENL_HDRLEN;
+
+	*(__u32 *)pcm_msg_attr(m, DC_GENL_ATTR_CARD, sizeof(__u32)) = card;
+	m->tstamp = pcm_msg_attr(m, DC_GENL_ATTR_PCM_TIMESTAMP, sizeof(__u64));
+	if (cmd == DC_GENL_CMD_PCM) {
+		m->sequence = pcm_msg_attr(m, DC_GENL_ATTR_PCM_SEQUENCE, sizeof(__u32));
+		m->samples = pcm_msg_attr(m, DC_GENL_ATTR_PCM_SAMPLES, sizeof(__u32));
+		m->data = (struct nlattr *)(m->hdr + m->hdr_len);
+		pcm_msg_attr(m, DC_GENL_ATTR_PCM_DATA, 0);
+	} else {
+		// the attribute is a dc_pcm_chunk_s, whose sequence precedes the samples
+		m->data = (struct nlattr *)(m->hdr + m->hdr_len);
+		pcm_msg_attr(m, DC_GENL_ATTR_S16LE_16K_100MS_PCM, 0);
+		m->sequence = (__u32 *)(m->hdr + m->hdr_len);
+		m->hdr_len += sizeof(__u32);
+	}
+
+	m->kernel.nl_family = AF_NETLINK;
+	m->iov[0].iov_base = m->hdr;
+	m->iov[0].iov_len = m->hdr_len;
+	m->iov[2].iov_base = (void *)pad;
+	m->mh.msg_name = &m->kernel;
+	m->mh.msg_namelen = sizeof(m->kernel);
+	m->mh.msg_iov = m->iov;
+	m->mh.msg_iovlen = 3;
+	return 0;
+}
+
+// data stays where it is until sendmsg() returns, len is in bytes
+static int pcm_msg_send(struct pcm_msg_s *m, const char *data, unsigned len,
+	unsigned sequence, unsigned long long tstamp)
+{
+	unsigned pad = NLA_ALIGN(len) - len;
+
+	*m->sequence = sequence;
+	if (m->samples)
+		*m->samples = len / DC_PCM_SAMPLE_BYTES;
+	memcpy(m->tstamp, &tstamp, sizeof(tstamp));
+	m->data->nla_len = m->hdr + m->hdr_len - (char *)m->data + len;
+	m->nlh->nlmsg_len = m->hdr_len + len + pad;
+	m->nlh->nlmsg_seq++;
+	m->iov[1].iov_base = (void *)data;
+	m->iov[1].iov_len = len;
+	m->iov[2].iov_len = pad;
+
+	if (sendmsg(m->fd, &m->mh, 0) < 0)
+		return -errno;
+	return 0;
+}
+
+// collects the errors the kernel answered with, without blocking
+static void pcm_msg_errors(struct pcm_msg_s *m)
+{
+	// the echoed request is cut short, only the error code matters
+	char buf[256] __attribute__((aligned(4)));
+	const struct nlmsghdr *nlh = (const struct nlmsghdr *)buf;
+	const struct nlmsgerr *e = NLMSG_DATA(nlh);
+
+	while (recv(m->fd, buf, sizeof(buf), MSG_DONTWAIT) >= (ssize_t)(NLMSG_HDRLEN + sizeof(e->error))) {
+		if (nlh->nlmsg_type != NLMSG_ERROR || !e->error)
+			continue;
+		if (!m->errors++ || verbose)
+			errprint("Frame rejected by the driver (message %u): %s\n", e->msg.nlmsg_seq, strerror(-e->error));
+	}
+}
+
+static void pcm_msg_free(struct pcm_msg_s *m)
+{
+	if (m->fd >= 0) {
+		pcm_msg_errors(m);
+		if (m->errors)
+			errprint("%lu frames rejected by the driver\n", m->errors);
+		close(m->fd);
+	}
+}
+
+static int on_feedback(struct nl_msg *msg, void *arg)
+{
+	struct feedback_s *fb = arg;
+	struct nlattr *attrs[DC_GENL_ATTR_MAX];
+
+	if (genlmsg_parse(nlmsg_hdr(msg), 0, attrs, DC_GENL_ATTR_MAX - 1, NULL) < 0)
+		return NL_SKIP;
+	if (!attrs[DC_GENL_ATTR_CARD] || nla_get_u32(attrs[DC_GENL_ATTR_CARD]) != fb->card)
+		return NL_SKIP;
+	if (!attrs[DC_GENL_ATTR_FB_FILL] || !attrs[DC_GENL_ATTR_FB_TARGET] || !attrs[DC_GENL_ATTR_FB_PERIOD_US])
+		return NL_SKIP;
+
+	fb->fill = nla_get_u32(attrs[DC_GENL_ATTR_FB_FILL]);
+	fb->target = nla_get_u32(attrs[DC_GENL_ATTR_FB_TARGET]);
+	fb->period_us = nla_get_u32(attrs[DC_GENL_ATTR_FB_PERIOD_US]);
+	if (attrs[DC_GENL_ATTR_FB_DROPS])
+		fb->drops = nla_get_u32(attrs[DC_GENL_ATTR_FB_DROPS]);
+	if (attrs[DC_GENL_ATTR_FB_UNDERRUNS])
+		fb->underruns = nla_get_u32(attrs[DC_GENL_ATTR_FB_UNDERRUNS]);
+	if (attrs[DC_GENL_ATTR_FB_LOST])
+		fb->lost = nla_get_u32(attrs[DC_GENL_ATTR_FB_LOST]);
+	if (attrs[DC_GENL_ATTR_FB_DRIFT_PPM])
+		fb->drift_ppm = (int)nla_get_u32(attrs[DC_GENL_ATTR_FB_DRIFT_PPM]);
+	fb->valid = 1;
+	return NL_OK;
+}
+
+// a socket of its own for one of the family's multicast groups
+static struct nl_sock *mcast_open(const char *group, nl_recvmsg_msg_cb_t cb, void *arg)
+{
+	struct nl_sock *sock = nl_socket_alloc();
+	int grp;
+
+	if (!sock)
+		return NULL;
+	nl_socket_disable_seq_check(sock);
+	nl_socket_modify_cb(sock, NL_CB_VALID, NL_CB_CUSTOM, cb, arg);
+	if (genl_connect(sock))
+		goto EARLY_OUT;
+	if ((grp = genl_ctrl_resolve_grp(sock, DC_GENL_FAMILY_NAME, group)) < 0) {
+		errprint("No multicast group %s (%s), driver too old?\n", group, nl_geterror(grp));
+		goto EARLY_OUT;
+	}
+	if (nl_socket_add_membership(sock, grp) < 0)
+		goto EARLY_OUT;
+	return sock;
+
+EARLY_OUT:
+	nl_socket_free(sock);
+	return NULL;
+}
+
+// feedback must never get in the way of sending, so it is polled
+static struct nl_sock *feedback_open(struct feedback_s *fb)
+{
+	struct nl_sock *sock = mcast_open(DC_GENL_MCGRP_FEEDBACK, on_feedback, fb);
+
+	if (sock && nl_socket_set_nonblocking(sock) < 0) {
+		nl_socket_free(sock);
+		return NULL;
+	}
+	return sock;
+}
+
+// --listen: what applications play to the virtual speaker
+struct listen_s {
+	unsigned card;
+	FILE *fp;
+	unsigned sequence;	/* last one written, 0: none yet */
+	unsigned len;		/* bytes of the last frame */
+};
+
+static int on_playback(struct nl_msg *msg, void *arg)
+{
+	static const char zero[DC_PCM_FRAME_MAX_LEN];
+	struct listen_s *ls = arg;
+	struct nlattr *attrs[DC_GENL_ATTR_MAX];
+	unsigned sequence, samples, lost;
+	unsigned long long tstamp = 0;
+
+	if (genlmsg_parse(nlmsg_hdr(msg), 0, attrs, DC_GENL_ATTR_MAX - 1, NULL) < 0)
+		return NL_SKIP;
+	if (!attrs[DC_GENL_ATTR_CARD] || nla_get_u32(attrs[DC_GENL_ATTR_CARD]) != ls->card)
+		return NL_SKIP;
+	if (!attrs[DC_GENL_ATTR_PCM_SEQUENCE] || !attrs[DC_GENL_ATTR_PCM_SAMPLES] || !attrs[DC_GENL_ATTR_PCM_DATA])
+		return NL_SKIP;
+
+	sequence = nla_get_u32(attrs[DC_GENL_ATTR_PCM_SEQUENCE]);
+	samples = nla_get_u32(attrs[DC_GENL_ATTR_PCM_SAMPLES]);
+	if (samples * DC_PCM_SAMPLE_BYTES > DC_PCM_FRAME_MAX_LEN ||
+	    nla_len(attrs[DC_GENL_ATTR_PCM_DATA]) < (int)(samples * DC_PCM_SAMPLE_BYTES))
+		return NL_SKIP;
+	if (attrs[DC_GENL_ATTR_PCM_TIMESTAMP])
+		tstamp = nla_get_u64(attrs[DC_GENL_ATTR_PCM_TIMESTAMP]);
+
+	// frames the driver or the socket dropped: keep the timeline with silence
+	// (a lower sequence is a new stream)
+	lost = ls->sequence && sequence > ls->sequence ? sequence - ls->sequence - 1 : 0;
+	if (lost) {
+		errprint("Lost %u frames before sequence %u\n", lost, sequence);
+		while (lost--)
+			fwrite(zero, 1, ls->len, ls->fp);
+	}
+
+	ls->len = samples * DC_PCM_SAMPLE_BYTES;
+	fwrite(nla_data(attrs[DC_GENL_ATTR_PCM_DATA]), 1, ls->len, ls->fp);
+	ls->sequence = sequence;
+	if (verbose)
+		errprint("Played sequence %u (%u samples, %.1f ms ago)\n", sequence, samples,
+			tstamp ? (monotonic_ns() - tstamp) / 1e6 : 0.0);
+	return NL_OK;
+}
+
+static int listen_playback(unsigned card, const char *path)
+{
+	struct listen_s ls = { .card = card };
+	struct nl_sock *sock;
+	int rc;
+
+	ls.fp = fopen(path, "w");
+	if (!ls.fp) {
+		errprint("Error opening %s\n", path);
+		return -1;
+	}
+
+	sock = mcast_open(DC_GENL_MCGRP_PLAYBACK, on_playback, &ls);
+	if (!sock) {
+		fclose(ls.fp);
+		return -1;
+	}
+
+	dbg("Writing what card %u plays to %s..\n", card, path);
+	while ((rc = nl_recvmsgs_default(sock)) >= 0 || rc == -NLE_NOMEM)
+		fflush(ls.fp);
+	errprint("nl_recvmsgs: %s\n", nl_geterror(rc));
+
+	nl_socket_free(sock);
+	fclose(ls.fp);
+	return rc;
+}
+
+/*
+ * Time until the next frame: nominal, but up to 20% longer or shorter
+ * while the driver's queue is above or below its target (5% per frame
+ * of error). Without feedback yet, or while the driver buffers up, nominal.
+ */
+static double pace_ms(const struct feedback_s *fb, double frame_ms, unsigned frame_len)
+{
+	double err;
+
+	if (!fb->valid || !fb->target)
+		return frame_ms;
+	err = ((double)fb->fill - fb->target) / frame_len;
+	if (err > 4) err = 4;
+	if (err < -4) err = -4;
+	return frame_ms * (1 + 0.05 * err);
+}
+
+// variable frames: half a capture period keeps one frame ahead of every
+// tick, between 2.5 and 20ms; returns the new frame length in bytes
+static unsigned pick_frame_len(const struct feedback_s *fb, unsigned frame_len)
+{
+	unsigned samples, len;
+
+	if (!fb->valid || !fb->period_us)
+		return frame_len;
+	samples = (unsigned long long)fb->period_us * DC_PCM_RATE / 2000000;
+	if (samples < DC_PCM_RATE / 400) samples = DC_PCM_RATE / 400;
+	if (samples > DC_PCM_RATE / 50) samples = DC_PCM_RATE / 50;
+	len = samples * DC_PCM_SAMPLE_BYTES;
+
+	// only follow real changes, not every rounding step
+	if (len * 4 > frame_len * 5 || len * 5 < frame_len * 4)
+		return len;
+	return frame_len;
+}
+
+/*
+ * Input prefetch: a reader thread fills one half of a double buffer while
+ * the sender drains the other, so file I/O never runs on the send schedule.
+ */
+#define PREFETCH_BYTES (64 * 1024)
+
+struct prefetch_s {
+	FILE *fp;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	char buf[2][PREFETCH_BYTES];
+	unsigned len[2];
+	int full[2];
+	int eof, stop;
+	unsigned cur, ofs; // sender side
+	unsigned long stalls; // times the sender had to wait for the reader
+};
+
+static void *prefetch_thread(void *arg)
+{
+	struct prefetch_s *pf = arg;
+	unsigned b = 0;
+	size_t n;
+
+	for (;;) {
+		pthread_mutex_lock(&pf->lock);
+		while (pf->full[b] && !pf->stop)
+			pthread_cond_wait(&pf->cond, &pf->lock);
+		pthread_mutex_unlock(&pf->lock);
+		if (pf->stop)
+			break;
+
+		n = fread(pf->buf[b], 1, PREFETCH_BYTES, pf->fp);
+
+		pthread_mutex_lock(&pf->lock);
+		pf->len[b] = n;
+		pf->full[b] = 1;
+		if (n < PREFETCH_BYTES)
+			pf->eof = 1;
+		pthread_cond_broadcast(&pf->cond);
+		pthread_mutex_unlock(&pf->lock);
+		if (n < PREFETCH_BYTES)
+			break;
+		b ^= 1;
+	}
+	return NULL;
+}
+
+static int prefetch_start(struct prefetch_s *pf, FILE *fp)
+{
+	memset(pf, 0, sizeof(*pf));
+	pf->fp = fp;
+	pthread_mutex_init(&pf->lock, NULL);
+	pthread_cond_init(&pf->cond, NULL);
+	if (pthread_create(&pf->thread, NULL, prefetch_thread, pf)) {
+		errprint("Unable to start the reader thread\n");
+		return -1;
+	}
+
+	// prime the first half, so the start isn't counted as a stall
+	pthread_mutex_lock(&pf->lock);
+	while (!pf->full[0] && !pf->eof)
+		pthread_cond_wait(&pf->cond, &pf->lock);
+	pthread_mutex_unlock(&pf->lock);
+	return 0;
+}
+
+static void prefetch_stop(struct prefetch_s *pf)
+{
+	pthread_mutex_lock(&pf->lock);
+	pf->stop = 1;
+	pthread_cond_broadcast(&pf->cond);
+	pthread_mutex_unlock(&pf->lock);
+	pthread_join(pf->thread, NULL);
+	pthread_cond_destroy(&pf->cond);
+	pthread_mutex_destroy(&pf->lock);
+}
+
+// copies up to len bytes of input, less only at the end of it
+static unsigned prefetch_read(struct prefetch_s *pf, char *dst, unsigned len)
+{
+	unsigned copied = 0, n;
+
+	while (copied < len) {
+		pthread_mutex_lock(&pf->lock);
+		if (!pf->full[pf->cur] && !pf->eof) {
+			pf->stalls++;
+			while (!pf->full[pf->cur] && !pf->eof)
+				pthread_cond_wait(&pf->cond, &pf->lock);
+		}
+		pthread_mutex_unlock(&pf->lock);
+		if (!pf->full[pf->cur])
+			break;
+
+		// the reader leaves a full buffer alone until we hand it back
+		n = pf->len[pf->cur] - pf->ofs;
+		if (n > len - copied)
+			n = len - copied;
+		memcpy(dst + copied, pf->buf[pf->cur] + pf->ofs, n);
+		copied += n;
+		pf->ofs += n;
+
+		if (pf->ofs == pf->len[pf->cur]) {
+			pthread_mutex_lock(&pf->lock);
+			pf->full[pf->cur] = 0;
+			pthread_cond_broadcast(&pf->cond);
+			pthread_mutex_unlock(&pf->lock);
+			pf->cur ^= 1;
+			pf->ofs = 0;
+		}
+	}
+	return copied;
+}
+
+// how late each send started relative to its deadline, 10us buckets up to 20ms
+#define JITTER_BUCKET_NS 10000
+#define JITTER_BUCKETS 2000
+
+struct jitter_s {
+	unsigned long n, hist[JITTER_BUCKETS + 1];
+	double sum, sumsq;
+	long long max_ns;
+	unsigned long resyncs;
+};
+
+static void jitter_add(struct jitter_s *j, long long late_ns)
+{
+	unsigned long long b;
+
+	if (late_ns < 0)
+		late_ns = 0;
+	b = late_ns / JITTER_BUCKET_NS;
+	j->hist[b < JITTER_BUCKETS ? b : JITTER_BUCKETS]++;
+	j->n++;
+	j->sum += late_ns;
+	j->sumsq += (double)late_ns * late_ns;
+	if (late_ns > j->max_ns)
+		j->max_ns = late_ns;
+}
+
+// upper edge of the bucket holding the given fraction of sends, in us
+static double jitter_percentile(const struct jitter_s *j, double p)
+{
+	unsigned long want = (unsigned long)(p * j->n + 0.5), seen = 0;
+	unsigned b;
+
+	for (b = 0; b < JITTER_BUCKETS; b++) {
+		seen += j->hist[b];
+		if (seen >= want)
+			return (b + 1) * JITTER_BUCKET_NS / 1000.0;
+	}
+	return j->max_ns / 1000.0;
+}
+
+static void jitter_report(const struct jitter_s *j, unsigned long stalls)
+{
+	double mean, sd;
+
+	if (!j->n)
+		return;
+	mean = j->sum / j->n;
+	sd = j->sumsq / j->n - mean * mean;
+	sd = sd > 0 ? sqrt(sd) : 0;
+	errprint("Send jitter over %lu frames: mean %.1fus sd %.1fus p50 <%.0fus p99 <%.0fus p99.9 <%.0fus max %.1fus\n",
+		j->n, mean / 1000, sd / 1000, jitter_percentile(j, 0.5), jitter_percentile(j, 0.99),
+		jitter_percentile(j, 0.999), j->max_ns / 1000.0);
+	if (stalls || j->resyncs)
+		errprint("Reader stalls: %lu, schedule restarts: %lu\n", stalls, j->resyncs);
+}
+
+static void timespec_add_ns(struct timespec *ts, long long ns)
+{
+	ns += ts->tv_nsec;
+	ts->tv_sec += ns / 1000000000LL;
+	ts->tv_nsec = ns % 1000000000LL;
+	if (ts->tv_nsec < 0) {
+		ts->tv_nsec += 1000000000LL;
+		ts->tv_sec--;
+	}
+}
+
+static unsigned long long timespec_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+/*
+ * Real-time setup of the sending thread: SCHED_FIFO at prio (0 keeps the
+ * normal policy), pinned to cpu (-1: any). Memory is locked so page faults
+ * don't add to the jitter. Failures are reported, not fatal.
+ */
+static void rt_setup(int prio, int cpu)
+{
+	if (cpu >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		if (sched_setaffinity(0, sizeof(set), &set))
+			errprint("Unable to pin to cpu %d: %s\n", cpu, strerror(errno));
+	}
+	if (prio > 0) {
+		struct sched_param sp = { .sched_priority = prio };
+		int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+		if (err)
+			errprint("Unable to set SCHED_FIFO %d: %s\n", prio, strerror(err));
+		if (mlockall(MCL_CURRENT | MCL_FUTURE))
+			errprint("mlockall: %s\n", strerror(errno));
+	}
+}
+
+static volatile sig_atomic_t stop_sending;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop_sending = 1;
+}
+
+// mmap ring transport: no netlink at all, the driver paces us via poll()
+static int send_ring(const char *dev, struct prefetch_s *pf, unsigned frame_len)
+{
+	int fd, rc = -1;
+	void *map;
+	struct dc_ring_ctl_s *ctl;
+	char *data;
+	unsigned head, mask;
+	char frame[DC_PCM_FRAME_MAX_LEN];
+
+	fd = open(dev, O_RDWR);
+	if (fd < 0) {
+		errprint("Error opening %s\n", dev);
+		return -1;
+	}
+
+	map = mmap(NULL, DC_RING_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		errprint("Unable to mmap %s\n", dev);
+		goto EARLY_OUT;
+	}
+
+	ctl = map;
+	data = (char *)map + DC_RING_CTL_SIZE;
+	if (ctl->magic != DC_RING_MAGIC || ctl->size != DC_RING_DATA_SIZE) {
+		errprint("Unexpected ring layout (magic=%x size=%u)\n", ctl->magic, ctl->size);
+		goto EARLY_OUT;
+	}
+	mask = ctl->size - 1;
+	head = ctl->head;
+	dbg("Mapped %s (watermark=%u).. writing pcm frames..\n", dev, ctl->watermark);
+
+	while (!stop_sending) {
+		struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+		unsigned ofs, first, n;
+
+		// blocks until the driver drained the ring below the watermark
+		if (poll(&pfd, 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			errprint("poll failed\n");
+			goto EARLY_OUT;
+		}
+		if (ctl->size - (head - __atomic_load_n(&ctl->tail, __ATOMIC_ACQUIRE)) < frame_len)
+			continue;
+
+		// a byte stream: the end of the input needs no padding
+		n = prefetch_read(pf, frame, frame_len) & ~(DC_PCM_SAMPLE_BYTES - 1);
+		if (!n)
+			break;
+
+		ofs = head & mask;
+		first = n < ctl->size - ofs ? n : ctl->size - ofs;
+		memcpy(data + ofs, frame, first);
+		memcpy(data, frame + first, n - first);
+
+		head += n;
+		__atomic_store_n(&ctl->head, head, __ATOMIC_RELEASE);
+	}
+	rc = 0;
+
+EARLY_OUT:
+	if (map != MAP_FAILED) munmap(map, DC_RING_MAP_SIZE);
+	close(fd);
+	return rc;
+}
+
+/*
+ * --frame-ms: variable frames of (about) that many milliseconds, sent as
+ * DC_GENL_CMD_PCM; 0 keeps the legacy 100ms chunks.
+ */
+static int frame_setup(double frame_ms, unsigned *frame_len, double *ms, int *cmd)
+{
+	unsigned samples;
+
+	if (frame_ms == 0) {
+		*frame_len = DC_PCM_CHUNK_DATA_LEN;
+		*ms = 100;
+		*cmd = DC_GENL_CMD_S16LE_16K_100MS_PCM;
+		return 0;
+	}
+	samples = (unsigned)(frame_ms * DC_PCM_RATE / 1000 + 0.5);
+	if (samples < 2 || samples * DC_PCM_SAMPLE_BYTES > DC_PCM_FRAME_MAX_LEN) {
+		errprint("--frame-ms must be between %.3f and %d\n",
+			2000.0 / DC_PCM_RATE, DC_PCM_FRAME_MAX_LEN / DC_PCM_SAMPLE_BYTES * 1000 / DC_PCM_RATE);
+		return -1;
+	}
+	*frame_len = samples * DC_PCM_SAMPLE_BYTES;
+	*ms = samples * 1000.0 / DC_PCM_RATE;
+	*cmd = DC_GENL_CMD_PCM;
+	return 0;
+}
+
+// the end of the input: variable frames are just shorter, fixed chunks padded
+static unsigned last_frame(int cmd, char *data, unsigned n, unsigned frame_len)
+{
+	if (cmd == DC_GENL_CMD_PCM || !n)
+		return n & ~(DC_PCM_SAMPLE_BYTES - 1);
+	memset(data + n, 0, frame_len - n);
+	return frame_len;
+}
+
+/*
+ * Sources: a file, a named pipe, "-" for stdin or "unix:<path>", a stream
+ * socket some decoder listens on. Anything but a regular file is live.
+ */
+static int source_open(const char *path)
+{
+	struct sockaddr_un sun = { .sun_family = AF_UNIX };
+	int fd;
+
+	if (strcmp(path, "-") == 0)
+		return dup(STDIN_FILENO);
+	if (strncmp(path, "unix:", 5) != 0)
+		return open(path, O_RDONLY | O_CLOEXEC);
+
+	if (strlen(path + 5) >= sizeof(sun.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(sun.sun_path, path + 5);
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd >= 0 && connect(fd, (struct sockaddr *)&sun, sizeof(sun)) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int source_is_live(const char *path)
+{
+	struct stat sb;
+
+	if (strcmp(path, "-") == 0 || strncmp(path, "unix:", 5) == 0)
+		return 1;
+	return stat(path, &sb) == 0 && !S_ISREG(sb.st_mode);
+}
+
+/*
+ * Multi-stream sender: each --stream has its own source, card, frame size
+ * and schedule (a timerfd armed for its next deadline), and all of them are
+ * served by one epoll loop on one thread. A stream costs a few descriptors,
+ * a netlink socket and this struct.
+ *
+ * Files are read a frame ahead. Live sources are read without blocking
+ * whenever they have data, and only whole frames are sent: a frame goes
+ * out at its deadline, or as soon as it is complete if the source was
+ * late, in which case the schedule restarts from there.
+ */
+struct stream_s {
+	unsigned card;
+	const char *path;
+	int fd;			// source
+	int tfd;		// timerfd
+	int epfd;		// the loop both are registered with
+	int cmd;
+	unsigned frame_len;
+	double frame_ms;
+	unsigned n;		// bytes of the next frame read so far
+	unsigned sequence;
+	int live, eof;
+	int due;		// live: the deadline passed before the frame was complete
+	unsigned long waits;	// live: frames the source was late for
+	struct timespec next;	// deadline of the next frame
+	struct pcm_msg_s pm;
+	struct feedback_s fb;
+	struct jitter_s jit;
+	char data[DC_PCM_FRAME_MAX_LEN];
+};
+
+struct streams_s {
+	struct stream_s *st;
+	unsigned count;
+};
+
+// epoll_event.data of a stream's timer and source, and of the feedback socket
+#define EV_TIMER(i)	((__u64)(i) << 1)
+#define EV_SOURCE(i)	((__u64)(i) << 1 | 1)
+#define EV_FEEDBACK	(~0ULL)
+
+// --stream <card>:<frame-ms>:<path>
+static int stream_parse(struct stream_s *st, const char *spec)
+{
+	char *end;
+
+	memset(st, 0, sizeof(*st));
+	st->card = strtoul(spec, &end, 0);
+	if (*end != ':')
+		return -1;
+	if (frame_setup(strtod(end + 1, &end), &st->frame_len, &st->frame_ms, &st->cmd) < 0 || *end != ':' || !end[1])
+		return -1;
+	st->path = end + 1;
+	return 0;
+}
+
+// files: reads the next frame ahead of its deadline, short only at the end
+static unsigned stream_read(struct stream_s *st)
+{
+	unsigned got = 0;
+	ssize_t r;
+
+	while (got < st->frame_len) {
+		r = read(st->fd, st->data + got, st->frame_len - got);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			break;
+		got += r;
+	}
+	return got;
+}
+
+static int stream_arm(struct stream_s *st)
+{
+	struct itimerspec its = { .it_value = st->next };
+
+	return timerfd_settime(st->tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+// live: wait for source data only while there is room for it; removed from
+// the set rather than masked, a hangup would be reported regardless
+static void stream_watch(struct stream_s *st, unsigned i, int on)
+{
+	struct epoll_event ev = { .events = EPOLLIN, .data.u64 = EV_SOURCE(i) };
+
+	epoll_ctl(st->epfd, on ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, st->fd, &ev);
+}
+
+// one feedback socket for all streams, each keeps the reports for its card
+static int on_streams_feedback(struct nl_msg *msg, void *arg)
+{
+	struct streams_s *ss = arg;
+	unsigned i;
+
+	for (i = 0; i < ss->count; i++)
+		on_feedback(msg, &ss->st[i].fb);
+	return NL_OK;
+}
+
+// sends the frame that is due and schedules the next; nonzero: stream ended
+static int stream_out(struct stream_s *st, unsigned i, int adapt)
+{
+	unsigned len = st->n, frame_len = st->frame_len;
+	unsigned long long tstamp;
+	int rc;
+
+	if (len < frame_len)
+		len = last_frame(st->cmd, st->data, len, frame_len);
+	if (!len)
+		return 1;
+
+	tstamp = timespec_ns(&st->next);
+	st->sequence++;
+	if (verbose)
+		errprint("Card %u: writing sequence %u (%u bytes)\n", st->card, st->sequence, len);
+	if ((rc = pcm_msg_send(&st->pm, st->data, len, st->sequence, tstamp)) < 0) {
+		errprint("Card %u: unable to send message (sendmsg): %s\n", st->card, strerror(-rc));
+		return -1;
+	}
+	if ((st->sequence & 15) == 0)
+		pcm_msg_errors(&st->pm);
+
+	if (adapt && st->cmd == DC_GENL_CMD_PCM) {
+		st->frame_len = pick_frame_len(&st->fb, frame_len);
+		st->frame_ms = st->frame_len * 1000.0 / (DC_PCM_RATE * DC_PCM_SAMPLE_BYTES);
+	}
+	timespec_add_ns(&st->next, (long long)(pace_ms(&st->fb, st->frame_ms, st->frame_len) * 1000000));
+	if (monotonic_ns() > timespec_ns(&st->next) + 1000000000ULL) {
+		clock_gettime(CLOCK_MONOTONIC, &st->next);
+		st->jit.resyncs++;
+	}
+
+	if (st->live) {
+		st->n = 0;
+		if (st->eof)
+			return 1;
+		stream_watch(st, i, 1);
+	} else {
+		st->n = stream_read(st);
+		if (!st->n)
+			return 1;
+	}
+	if (stream_arm(st) < 0) {
+		errprint("Card %u: timerfd_settime: %s\n", st->card, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+// the stream's deadline passed
+static int stream_fire(struct stream_s *st, unsigned i, int adapt)
+{
+	unsigned long long expirations;
+
+	if (read(st->tfd, &expirations, sizeof(expirations)) < 0)
+		return 0;
+	if (st->live && st->n < st->frame_len && !st->eof) {
+		st->due = 1;
+		st->waits++;
+		return 0;
+	}
+	jitter_add(&st->jit, (long long)(monotonic_ns() - timespec_ns(&st->next)));
+	return stream_out(st, i, adapt);
+}
+
+// a live source has data (or hung up): take what fits into the frame
+static int stream_fill(struct stream_s *st, unsigned i, int adapt)
+{
+	ssize_t r;
+
+	if (st->n == st->frame_len || st->eof)
+		return 0;
+	r = read(st->fd, st->data + st->n, st->frame_len - st->n);
+	if (r > 0) {
+		st->n += r;
+	} else if (r == 0 || (errno != EAGAIN && errno != EINTR)) {
+		if (r < 0)
+			errprint("Card %u: reading %s: %s\n", st->card, st->path, strerror(errno));
+		st->eof = 1;
+	}
+	if (st->n < st->frame_len && !st->eof)
+		return 0;
+
+	// complete (or the last one): nothing more to read until it is sent
+	stream_watch(st, i, 0);
+	if (!st->due)
+		return 0;
+	st->due = 0;
+	clock_gettime(CLOCK_MONOTONIC, &st->next);
+	return stream_out(st, i, adapt);
+}
+
+static int send_streams(struct stream_s *streams, unsigned count, int family_id, int adapt)
+{
+	struct streams_s ss = { streams, count };
+	struct epoll_event ev, events[16];
+	struct nl_sock *fb_sock = NULL;
+	unsigned i, active = 0;
+	int epfd, n, rc = -1;
+
+	for (i = 0; i < count; i++) {
+		streams[i].fd = streams[i].tfd = streams[i].pm.fd = -1;
+		streams[i].fb.card = streams[i].card;
+	}
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0) {
+		errprint("epoll_create1: %s\n", strerror(errno));
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct stream_s *st = &streams[i];
+
+		st->epfd = epfd;
+		st->live = source_is_live(st->path);
+		st->fd = source_open(st->path);
+		if (st->fd < 0) {
+			errprint("Error opening %s: %s\n", st->path, strerror(errno));
+			goto EARLY_OUT;
+		}
+		if (pcm_msg_init(&st->pm, family_id, st->cmd, st->card) < 0)
+			goto EARLY_OUT;
+		st->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		if (st->tfd < 0) {
+			errprint("timerfd_create: %s\n", strerror(errno));
+			goto EARLY_OUT;
+		}
+		ev.events = EPOLLIN;
+		ev.data.u64 = EV_TIMER(i);
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, st->tfd, &ev) < 0) {
+			errprint("epoll_ctl: %s\n", strerror(errno));
+			goto EARLY_OUT;
+		}
+
+		if (st->live) {
+			// the first frame starts the schedule as soon as it is complete
+			fcntl(st->fd, F_SETFL, fcntl(st->fd, F_GETFL) | O_NONBLOCK);
+			ev.data.u64 = EV_SOURCE(i);
+			if (epoll_ctl(epfd, EPOLL_CTL_ADD, st->fd, &ev) < 0) {
+				errprint("epoll_ctl: %s\n", strerror(errno));
+				goto EARLY_OUT;
+			}
+			st->due = 1;
+		} else {
+			posix_fadvise(st->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+			st->n = stream_read(st);
+			if (!st->n) {
+				errprint("%s is empty\n", st->path);
+				continue;
+			}
+			clock_gettime(CLOCK_MONOTONIC, &st->next);
+			if (stream_arm(st) < 0) {
+				errprint("timerfd_settime: %s\n", strerror(errno));
+				goto EARLY_OUT;
+			}
+		}
+		dbg("Stream %u: %s%s to card %u, %u byte frames (%.2f ms)\n", i, st->path,
+			st->live ? " (live)" : "", st->card, st->frame_len, st->frame_ms);
+		active++;
+	}
+
+	if (adapt) {
+		fb_sock = mcast_open(DC_GENL_MCGRP_FEEDBACK, on_streams_feedback, &ss);
+		ev.events = EPOLLIN;
+		ev.data.u64 = EV_FEEDBACK;
+		if (!fb_sock || nl_socket_set_nonblocking(fb_sock) < 0
+			|| epoll_ctl(epfd, EPOLL_CTL_ADD, nl_socket_get_fd(fb_sock), &ev) < 0)
+			errprint("Feedback unavailable, pacing blindly\n");
+	}
+
+	while (active && !stop_sending) {
+		n = epoll_wait(epfd, events, sizeof(events) / sizeof(events[0]), -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			errprint("epoll_wait: %s\n", strerror(errno));
+			goto EARLY_OUT;
+		}
+		for (i = 0; i < (unsigned)n; i++) {
+			__u64 tag = events[i].data.u64;
+			unsigned idx = tag >> 1;
+			struct stream_s *st;
+
+			if (tag == EV_FEEDBACK) {
+				while (nl_recvmsgs_default(fb_sock) == 0)
+					;
+				continue;
+			}
+			st = &streams[idx];
+			// an earlier event of this round may have ended the stream
+			if (st->tfd < 0)
+				continue;
+			if ((tag & 1 ? stream_fill(st, idx, adapt) : stream_fire(st, idx, adapt)) == 0)
+				continue;
+			// closing the descriptors also takes them out of the epoll set
+			close(st->tfd);
+			st->tfd = -1;
+			close(st->fd);
+			st->fd = -1;
+			active--;
+		}
+	}
+	rc = 0;
+
+EARLY_OUT:
+	for (i = 0; i < count; i++) {
+		struct stream_s *st = &streams[i];
+
+		if (st->sequence) {
+			errprint("Stream %u (%s to card %u), %u frames:\n", i, st->path, st->card, st->sequence);
+			jitter_report(&st->jit, 0);
+			if (st->waits)
+				errprint("Waited for the source %lu times\n", st->waits);
+		}
+		pcm_msg_free(&st->pm);
+		if (st->tfd >= 0) close(st->tfd);
+		if (st->fd >= 0) close(st->fd);
+	}
+	if (fb_sock) nl_socket_free(fb_sock);
+	close(epfd);
+	return rc;
+}
+
+static void usage(const char *prog)
+{
+	errprint("Usage: %s [--card <n>] [--frame-ms <ms>] [--adapt] [--ring] [--rt <prio>] [--cpu <n>] [-v] <audio.pcm>\n", prog);
+	errprint("       %s [--adapt] [--rt <prio>] [--cpu <n>] [-v] --stream <card>:<frame-ms>:<path> [--stream ...]\n", prog);
+	errprint("       %s [--card <n>] --listen <out.pcm>\n", prog);
+	errprint("  <audio.pcm> a file, a named pipe, - for stdin or unix:<path> (a socket to connect to)\n");
+	errprint("  --card      virtual mic to feed (enable[] index of the driver, default 0)\n");
+	errprint("  --frame-ms  send variable length frames of <ms> milliseconds (e.g. 2.5, 5, 10, 20)\n");
+	errprint("              instead of fixed 100ms chunks\n");
+	errprint("  --adapt     pace by the driver's feedback (DC_GENL_CMD_FEEDBACK), and with --frame-ms\n");
+	errprint("              follow its capture period with the frame size\n");
+	errprint("  --ring      write into the mmap ring (" DC_RING_DEV_PREFIX "<n>) instead of using netlink\n");
+	errprint("  --rt        send from a SCHED_FIFO thread of priority <prio> (1-99) with memory locked\n");
+	errprint("  --cpu       pin the sending thread to cpu <n>\n");
+	errprint("  --stream    one of several streams sent from a single thread, each to its own card with\n");
+	errprint("              its own frame size (0: 100ms chunks) and schedule\n");
+	errprint("  --verbose   log every frame sent or listened to\n");
+	errprint("  --listen    record what applications play to the card's virtual speaker\n");
+	errprint("              (S16LE 16kHz mono, lost frames filled with silence)\n");
+}
+
 int main(int argc, char* argv[])
 {
 	int rc = 0;
-	struct nl_msg *msg = 0;
 	struct unl_s unl = {0};
+	struct pcm_msg_s pm = { .fd = -1 };
 	struct dc_pcm_chunk_s pcm_chunk;
 	FILE * fp;
+	const char *path = NULL, *listen_path = NULL;
+	double frame_ms = 0; // 0: legacy 100ms chunks
+	unsigned frame_len = DC_PCM_CHUNK_DATA_LEN;
+	int cmd = DC_GENL_CMD_S16LE_16K_100MS_PCM;
+	int use_ring = 0, adapt = 0;
+	unsigned card = 0;
+	struct nl_sock *fb_sock = NULL;
+	struct feedback_s fb = {0};
+	unsigned long long tstamp;
+	char ring_dev[64];
+	struct prefetch_s *pf = NULL;
+	struct stream_s *streams = NULL;
+	unsigned nstreams = 0;
+	struct jitter_s jit = {0};
+	struct timespec next;
+	int rt_prio = 0, cpu = -1;
+	unsigned n;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--frame-ms") == 0 && i + 1 < argc) {
+			frame_ms = strtod(argv[++i], NULL);
+		} else if (strcmp(argv[i], "--card") == 0 && i + 1 < argc) {
+			card = strtoul(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--ring") == 0) {
+			use_ring = 1;
+		} else if (strcmp(argv[i], "--adapt") == 0) {
+			adapt = 1;
+		} else if (strcmp(argv[i], "--rt") == 0 && i + 1 < argc) {
+			rt_prio = strtol(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+			cpu = strtol(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+			struct stream_s *more = realloc(streams, (nstreams + 1) * sizeof(*streams));
+			if (!more)
+				goto EARLY_OUT;
+			streams = more;
+			if (stream_parse(&streams[nstreams], argv[++i]) < 0) {
+				errprint("Bad --stream %s, expected <card>:<frame-ms>:<path>\n", argv[i]);
+				goto EARLY_OUT;
+			}
+			nstreams++;
+		} else if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0) {
+			verbose = 1;
+		} else if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc) {
+			listen_path = argv[++i];
+		} else if ((argv[i][0] == '-' && argv[i][1]) || path) {
+			usage(argv[0]);
+			goto EARLY_OUT;
+		} else {
+			path = argv[i];
+		}
+	}
+
+	if (listen_path && !path && !nstreams) {
+		listen_playback(card, listen_path);
+		goto EARLY_OUT;
+	}
 
-	if (argc != 2) {
-		errprint("Usage: %s <audio.pcm>\n", argv[0]);
+	if (nstreams ? path || listen_path || use_ring : !path || listen_path) {
+		usage(argv[0]);
 		goto EARLY_OUT;
 	}
 
-	fp = fopen(argv[1], "r");
-	if (!fp) {
-		errprint("Error opening %s\n", argv[1]);
+	if (frame_setup(frame_ms, &frame_len, &frame_ms, &cmd) < 0)
+		goto EARLY_OUT;
+
+	// live sources are sent like a --stream, frames as they come in
+	if (!nstreams && !use_ring && source_is_live(path)) {
+		streams = malloc(sizeof(*streams));
+		if (!streams)
+			goto EARLY_OUT;
+		memset(streams, 0, sizeof(*streams));
+		streams->card = card;
+		streams->path = path;
+		streams->cmd = cmd;
+		streams->frame_len = frame_len;
+		streams->frame_ms = frame_ms;
+		nstreams = 1;
+	}
+
+	if (!nstreams) {
+		int fd = source_open(path);
+		fp = fd < 0 ? NULL : fdopen(fd, "r");
+		if (!fp) {
+			errprint("Error opening %s\n", path);
+			if (fd >= 0) close(fd);
+			goto EARLY_OUT;
+		}
+
+		// the reader is started first so it doesn't inherit the real-time settings
+		pf = malloc(sizeof(*pf));
+		if (!pf || prefetch_start(pf, fp) < 0) {
+			free(pf);
+			pf = NULL;
+			fclose(fp);
+			goto EARLY_OUT;
+		}
+	}
+	rt_setup(rt_prio, cpu);
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	if (use_ring) {
+		snprintf(ring_dev, sizeof(ring_dev), DC_RING_DEV_PREFIX "%u", card);
+		send_ring(ring_dev, pf, frame_len);
 		goto EARLY_OUT;
 	}
 
@@ -67,47 +1218,102 @@ int main(int argc, char* argv[])
 	}
 	unl.family_id = rc;
 	dbg("Found family: %s (id=%d).. sending pcm chunks..\n", unl.family_name, unl.family_id);
+	// libnl was only needed to look up the family
+	nl_socket_free(unl.sock);
+	unl.sock = NULL;
 
-	nlmsg_set_default_size(DC_PCM_CHINK_MSG_SIZE);
-	while (!feof(fp)) {
-		msg = nlmsg_alloc();
-		if (!msg) {
-			errprint("Unable to allocate netlink message\n");
-			goto EARLY_OUT;
-		}
+	if (nstreams) {
+		send_streams(streams, nstreams, unl.family_id, adapt);
+		goto EARLY_OUT;
+	}
 
-		if (!genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ, unl.family_id, 0, 0, DC_GENL_CMD_S16LE_16K_100MS_PCM, DC_GENL_VERSION)) {
-			errprint("Unable to write genl header\n");
-			goto EARLY_OUT;
-		}
+	if (pcm_msg_init(&pm, unl.family_id, cmd, card) < 0)
+		goto EARLY_OUT;
+	if (cmd == DC_GENL_CMD_PCM)
+		dbg("Using %u byte frames (%.2f ms)\n", frame_len, frame_ms);
+
+	if (adapt) {
+		fb.card = card;
+		fb_sock = feedback_open(&fb);
+		if (!fb_sock)
+			errprint("Feedback unavailable, pacing blindly\n");
+	}
+
+	pcm_chunk.sequence = 0;
+
+	// frames go out on an absolute schedule, so the time spent sending
+	// and reading doesn't accumulate as drift
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!stop_sending) {
+		n = prefetch_read(pf, pcm_chunk.data, frame_len);
+		if (n < frame_len)
+			n = last_frame(cmd, pcm_chunk.data, n, frame_len);
+		if (!n)
+			break;
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR && !stop_sending)
+			;
+		if (stop_sending)
+			break;
+		// the file is "captured" on schedule
+		tstamp = timespec_ns(&next);
+		jitter_add(&jit, (long long)(monotonic_ns() - tstamp));
 
 		pcm_chunk.sequence ++;
-		memset(pcm_chunk.data, 0, DC_PCM_CHUNK_DATA_LEN);
-		fread(pcm_chunk.data, 1, DC_PCM_CHUNK_DATA_LEN, fp);
-		errprint("Writing sequence %d [ %x %X %x ... %x %x %x]\n", pcm_chunk.sequence, \
-			pcm_chunk.data[0] & 0xff,\
-			pcm_chunk.data[1] & 0xff,\
-			pcm_chunk.data[2] & 0xff,\
-			pcm_chunk.data[DC_PCM_CHUNK_DATA_LEN -3]&0xff,\
-			pcm_chunk.data[DC_PCM_CHUNK_DATA_LEN -2]&0xff,\
-			pcm_chunk.data[DC_PCM_CHUNK_DATA_LEN -1]&0xff);
-		if ((rc = nla_put(msg,  DC_GENL_ATTR_S16LE_16K_100MS_PCM, DC_PCM_CHUNK_BYTES, &pcm_chunk)) < 0) {
-			errprint("Unable to add attribute (nla_put): %s\n", nl_geterror(rc));
+		if (verbose)
+			errprint("Writing sequence %d (%u bytes) [ %x %X ... %x %x]\n", pcm_chunk.sequence, n, \
+				pcm_chunk.data[0] & 0xff,\
+				pcm_chunk.data[1] & 0xff,\
+				pcm_chunk.data[n -2]&0xff,\
+				pcm_chunk.data[n -1]&0xff);
+
+		if ((rc = pcm_msg_send(&pm, pcm_chunk.data, n, pcm_chunk.sequence, tstamp)) < 0) {
+			errprint("Unable to send message (sendmsg): %s\n", strerror(-rc));
 			goto EARLY_OUT;
 		}
+		if ((pcm_chunk.sequence & 15) == 0)
+			pcm_msg_errors(&pm);
 
-		if ((rc = nl_send_auto(unl.sock, msg)) < 0) {
-			errprint("Unable to send message (nl_send_auto): %s\n", nl_geterror(rc));
-			goto EARLY_OUT;
+		if (fb_sock) {
+			unsigned seen = fb.valid;
+			struct pollfd pfd = { .fd = nl_socket_get_fd(fb_sock), .events = POLLIN };
+			// drain whatever arrived, the newest report wins; polled first
+			// since libnl allocates a receive buffer per call
+			if (poll(&pfd, 1, 0) > 0)
+				while (nl_recvmsgs_default(fb_sock) == 0)
+					;
+			if (fb.valid && !seen)
+				dbg("Feedback: fill=%u target=%u period=%uus drift=%dppm\n",
+					fb.fill, fb.target, fb.period_us, fb.drift_ppm);
+			if (cmd == DC_GENL_CMD_PCM) {
+				unsigned len = pick_frame_len(&fb, frame_len);
+				if (len != frame_len) {
+					dbg("Frame size %u -> %u bytes (capture period %uus)\n", frame_len, len, fb.period_us);
+					frame_len = len;
+					frame_ms = frame_len * 1000.0 / (DC_PCM_RATE * DC_PCM_SAMPLE_BYTES);
+				}
+			}
 		}
+		timespec_add_ns(&next, (long long)(pace_ms(&fb, frame_ms, frame_len) * 1000000));
 
-		nlmsg_free(msg);
-		msg = NULL;
-		usleep(100000); // 100 ms?
+		// more than a second behind (suspend, stalled input): start over
+		// rather than bursting out everything that is overdue
+		if (monotonic_ns() > timespec_ns(&next) + 1000000000ULL) {
+			clock_gettime(CLOCK_MONOTONIC, &next);
+			jit.resyncs++;
+		}
 	}
 
 EARLY_OUT:
-	if (msg) nlmsg_free(msg);
+	if (pf) {
+		jitter_report(&jit, pf->stalls);
+		prefetch_stop(pf);
+		fclose(pf->fp);
+		free(pf);
+	}
+	pcm_msg_free(&pm);
+	free(streams);
+	if (fb_sock) nl_socket_free(fb_sock);
 	if (unl.sock) nl_socket_free(unl.sock);
 	return 0;
 }
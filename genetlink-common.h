@@ -1,30 +1,86 @@
 #ifndef GENL_TEST_COMMON_H
 #define GENL_TEST_COMMON_H
 
+#include <linux/types.h>
+
 // attributes
 enum {
 	DC_GENL_ATTR_UNSPEC,
 	DC_GENL_ATTR_S16LE_16K_100MS_PCM,
+	DC_GENL_ATTR_PCM_SEQUENCE,	/* u32 */
+	DC_GENL_ATTR_PCM_SAMPLES,	/* u32, number of samples in PCM_DATA */
+	DC_GENL_ATTR_PCM_DATA,		/* S16LE 16kHz mono, 2 * PCM_SAMPLES bytes */
+	DC_GENL_ATTR_CARD,		/* u32, target virtual mic (enable[] index), 0 if absent */
+	DC_GENL_ATTR_PCM_TIMESTAMP,	/* u64, CLOCK_MONOTONIC ns when the first sample was captured */
+	/* DC_GENL_CMD_FEEDBACK, along with DC_GENL_ATTR_CARD */
+	DC_GENL_ATTR_FB_FILL,		/* u32, bytes queued in the driver (jitter buffer or ring) */
+	DC_GENL_ATTR_FB_TARGET,		/* u32, fill level the driver steers to, 0 while it buffers up */
+	DC_GENL_ATTR_FB_DROPS,		/* u32, chunks dropped so far (late, duplicate or no room) */
+	DC_GENL_ATTR_FB_UNDERRUNS,	/* u32, capture ticks the sender was behind */
+	DC_GENL_ATTR_FB_LOST,		/* u32, chunks missing from the sequence */
+	DC_GENL_ATTR_FB_DRIFT_PPM,	/* u32 holding an s32, sender clock vs ours, > 0: sender fast */
+	DC_GENL_ATTR_FB_PERIOD_US,	/* u32, capture period; frames longer than this add latency */
 	DC_GENL_ATTR_MAX,
 };
 
 // commands
 enum {
 	DC_GENL_CMD_UNSPEC,
-	DC_GENL_CMD_S16LE_16K_100MS_PCM,
+	DC_GENL_CMD_S16LE_16K_100MS_PCM,	/* fixed 100ms dc_pcm_chunk_s */
+	DC_GENL_CMD_PCM,			/* variable length frame */
+	DC_GENL_CMD_FEEDBACK,			/* kernel -> DC_GENL_MCGRP_FEEDBACK, while capturing */
+	DC_GENL_CMD_PLAYBACK,			/* kernel -> DC_GENL_MCGRP_PLAYBACK, a played frame */
 	DC_GENL_CMD_MAX,
 };
 
+// multicast group of DC_GENL_CMD_FEEDBACK, sent every feedback_ms per card
+#define DC_GENL_MCGRP_FEEDBACK "feedback"
+// multicast group of DC_GENL_CMD_PLAYBACK: what applications play to the
+// virtual speaker, one frame per period with the same attributes as
+// DC_GENL_CMD_PCM (CARD, PCM_SEQUENCE, PCM_SAMPLES, PCM_DATA, PCM_TIMESTAMP);
+// the timestamp is when the first sample was played
+#define DC_GENL_MCGRP_PLAYBACK "playback"
+
 #define DC_GENL_FAMILY_NAME "DROIDCAM_SND"
-#define DC_GENL_VERSION 1
+#define DC_GENL_VERSION 2
+
+#define DC_PCM_RATE             16000
+#define DC_PCM_SAMPLE_BYTES     2
 
 #define DC_PCM_CHUNK_DATA_LEN   3200 /* 16kHz 16-bit 100ms */
 #define DC_PCM_CHINK_MSG_SIZE   4096 /* rounded up to nearest ^2 */
 #define DC_PCM_CHUNK_BYTES      sizeof(struct dc_pcm_chunk_s)
 
+/* DC_GENL_CMD_PCM frames may be anything from one sample up to 100ms */
+#define DC_PCM_FRAME_MAX_LEN    DC_PCM_CHUNK_DATA_LEN
+
 struct dc_pcm_chunk_s {
 	unsigned sequence;
 	char data[DC_PCM_CHUNK_DATA_LEN];
 };
 
+/*
+ * mmap ring transport, an alternative to netlink.
+ * /dev/droidcam_ringN maps a control page followed by the data area, which
+ * holds a byte stream of S16LE 16kHz mono. Userspace is the only producer
+ * (writes data, then advances head), the capture timer the only consumer.
+ * poll() reports POLLOUT while the fill level is below the watermark.
+ */
+#define DC_RING_DEV_PREFIX      "/dev/droidcam_ring"
+#define DC_RING_MAGIC           0x44435247 /* "DCRG" */
+#define DC_RING_VERSION         1
+#define DC_RING_CTL_SIZE        4096
+#define DC_RING_DATA_SIZE       (64 * 1024) /* power of 2 */
+#define DC_RING_MAP_SIZE        (DC_RING_CTL_SIZE + DC_RING_DATA_SIZE)
+
+struct dc_ring_ctl_s {
+	__u32 magic;
+	__u32 version;
+	__u32 size;		/* bytes in the data area */
+	__u32 watermark;	/* fill level (bytes) below which the producer is woken */
+	/* free running byte counters, each on its own cache line */
+	__u32 head __attribute__((aligned(64)));	/* written by the producer */
+	__u32 tail __attribute__((aligned(64)));	/* written by the kernel */
+};
+
 #endif
@@ -0,0 +1,579 @@
+/*
+ * End to end benchmark of the virtual mic. Generates a stream of audio with
+ * numbered markers in it, feeds it through the sender (by default
+ * "./a.out --frame-ms 10 -", reading stdin), records the card with alsa-lib
+ * and reports
+ * - latency: from the moment a marker is handed to the sender until the
+ *   recording application reads it (percentiles, mean)
+ * - jitter: how much that latency varies
+ * - dropouts: markers that never arrived, stretches that came out longer or
+ *   shorter than they went in (concealment, drift compensation, xruns)
+ * - a sample accurate diff of the audio between markers against the source
+ *
+ * Usage: ./latency-bench [-D <device>] [--source <pcm>] [--seconds <s>]
+ *        [--marker-ms <ms>] [--capture-ms <ms>] [--csv <file>] [-- sender ...]
+ * "make bench" builds and runs it (BENCH_DEVICE, SENDER_ARGS).
+ *
+ * The driver passes S16LE 16kHz mono through bit exact unless it resamples
+ * (drift_comp=1 while the clocks differ) or conceals lost audio, so those
+ * show up as altered or slipped segments.
+ */
+#include <alsa/asoundlib.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "genetlink-common.h"
+
+#define errprint(...) fprintf(stderr, __VA_ARGS__)
+
+/*
+ * A marker: 31 chips of a maximum length sequence, two samples per chip,
+ * then the marker number and its complement, 16 bits each, four samples
+ * per bit. 190 samples, about 12ms.
+ */
+#define SYNC_CHIPS		31
+#define CHIP_SAMPLES		2
+#define SYNC_SAMPLES		(SYNC_CHIPS * CHIP_SAMPLES)
+#define BIT_SAMPLES		4
+#define CODE_BITS		32
+#define MARKER_SAMPLES		(SYNC_SAMPLES + CODE_BITS * BIT_SAMPLES)
+#define MARKER_AMPLITUDE	12000
+#define SYNC_THRESHOLD		0.8
+
+#define WRITE_SAMPLES		(DC_PCM_RATE / 200)	/* 5ms per write to the sender */
+#define WARMUP_MS		1000			/* no markers while everything starts */
+#define TAIL_MS			2000			/* keep recording after the input ends */
+
+static int sync_chip[SYNC_CHIPS];
+
+struct read_s {
+	unsigned long end;		// capture position after this read
+	unsigned long long t;		// when it returned
+};
+
+struct bench_s {
+	// what is fed to the sender
+	short *src;
+	unsigned long src_len;
+	unsigned long first;		// position of marker 0
+	unsigned interval;		// samples from one marker to the next
+	unsigned markers;
+	unsigned long long *inject_ns;	// when each marker was written to the sender
+	int fd;				// the sender's stdin
+
+	// what was recorded
+	short *cap;
+	unsigned long cap_len, cap_max;
+	struct read_s *reads;
+	unsigned long nreads;
+	unsigned long xruns;
+
+	// analysis
+	long *found;			// capture position of each marker, -1: missing
+	unsigned long duplicates;
+};
+
+static volatile sig_atomic_t stop_bench;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop_bench = 1;
+}
+
+static unsigned long long monotonic_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// x^5 + x^3 + 1
+static void sync_init(void)
+{
+	unsigned lfsr = 0x1f, i, bit;
+
+	for (i = 0; i < SYNC_CHIPS; i++) {
+		sync_chip[i] = lfsr & 1 ? 1 : -1;
+		bit = ((lfsr >> 4) ^ (lfsr >> 2)) & 1;
+		lfsr = ((lfsr << 1) | bit) & 0x1f;
+	}
+}
+
+static void marker_write(short *dst, unsigned id)
+{
+	unsigned code = (id & 0xffff) | (~id & 0xffff) << 16;
+	unsigned i, b;
+
+	for (i = 0; i < SYNC_SAMPLES; i++)
+		dst[i] = sync_chip[i / CHIP_SAMPLES] * MARKER_AMPLITUDE;
+	for (b = 0; b < CODE_BITS; b++)
+		for (i = 0; i < BIT_SAMPLES; i++)
+			dst[SYNC_SAMPLES + b * BIT_SAMPLES + i] = (code >> b) & 1 ? MARKER_AMPLITUDE : -MARKER_AMPLITUDE;
+}
+
+// the marker number at x, -1 if the code doesn't check out
+static long marker_read(const short *x)
+{
+	unsigned code = 0, b, i;
+	long sum;
+
+	for (b = 0; b < CODE_BITS; b++) {
+		for (sum = 0, i = 0; i < BIT_SAMPLES; i++)
+			sum += x[SYNC_SAMPLES + b * BIT_SAMPLES + i];
+		if (sum > 0)
+			code |= 1u << b;
+	}
+	if ((code & 0xffff) != (~code >> 16 & 0xffff))
+		return -1;
+	return code & 0xffff;
+}
+
+// normalized correlation of x with the sync sequence
+static double sync_corr(const short *x)
+{
+	double xp = 0, xx = 0;
+	unsigned i;
+
+	for (i = 0; i < SYNC_SAMPLES; i++) {
+		xp += (double)x[i] * sync_chip[i / CHIP_SAMPLES];
+		xx += (double)x[i] * x[i];
+	}
+	return xx > 0 ? xp / sqrt(xx * SYNC_SAMPLES) : 0;
+}
+
+/*
+ * The stream: the source file over and over (a quiet 440Hz tone without
+ * one), with a marker every interval after the warmup.
+ */
+static int source_build(struct bench_s *b, const char *path, unsigned seconds, unsigned marker_ms)
+{
+	FILE *fp = path ? fopen(path, "r") : NULL;
+	unsigned long pos, n = 0;
+	unsigned k;
+
+	b->src_len = (unsigned long)seconds * DC_PCM_RATE;
+	b->interval = marker_ms * DC_PCM_RATE / 1000 / WRITE_SAMPLES * WRITE_SAMPLES;
+	b->first = WARMUP_MS * DC_PCM_RATE / 1000 / WRITE_SAMPLES * WRITE_SAMPLES;
+	if (b->interval < MARKER_SAMPLES * 2 || b->src_len < b->first + MARKER_SAMPLES) {
+		errprint("--marker-ms or --seconds too small\n");
+		return -1;
+	}
+	b->markers = (b->src_len - b->first - MARKER_SAMPLES) / b->interval + 1;
+	if (b->markers > 0xffff)
+		b->markers = 0xffff;
+
+	b->src = malloc(b->src_len * sizeof(short));
+	b->inject_ns = calloc(b->markers, sizeof(*b->inject_ns));
+	if (!b->src || !b->inject_ns)
+		return -1;
+
+	if (fp) {
+		while (n < b->src_len) {
+			size_t r = fread(b->src + n, sizeof(short), b->src_len - n, fp);
+			if (!r && !n)
+				break;
+			n += r;
+			if (!r || feof(fp))
+				rewind(fp);
+		}
+		fclose(fp);
+	} else if (path) {
+		errprint("Unable to open %s, using a tone\n", path);
+	}
+	for (pos = n; pos < b->src_len; pos++)
+		b->src[pos] = (short)(3000 * sin(2 * M_PI * 440 * pos / DC_PCM_RATE));
+
+	for (k = 0; k < b->markers; k++)
+		marker_write(b->src + b->first + (unsigned long)k * b->interval, k);
+	return 0;
+}
+
+// hands the stream to the sender in real time, 5ms at a time
+static void *writer_thread(void *arg)
+{
+	struct bench_s *b = arg;
+	struct timespec next;
+	unsigned long pos, ofs;
+	ssize_t r;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (pos = 0; pos < b->src_len && !stop_bench; pos += WRITE_SAMPLES) {
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+			;
+		if (pos >= b->first && (pos - b->first) % b->interval == 0 && (pos - b->first) / b->interval < b->markers)
+			b->inject_ns[(pos - b->first) / b->interval] = monotonic_ns();
+
+		for (ofs = 0; ofs < WRITE_SAMPLES * sizeof(short); ofs += r) {
+			r = write(b->fd, (char *)(b->src + pos) + ofs, WRITE_SAMPLES * sizeof(short) - ofs);
+			if (r < 0 && errno == EINTR)
+				r = 0;
+			if (r < 0) {
+				errprint("Writing to the sender: %s\n", strerror(errno));
+				goto EARLY_OUT;
+			}
+		}
+
+		next.tv_nsec += WRITE_SAMPLES * (1000000000LL / DC_PCM_RATE);
+		if (next.tv_nsec >= 1000000000L) {
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+	}
+
+EARLY_OUT:
+	// the sender sees the end of its input and exits
+	close(b->fd);
+	b->fd = -1;
+	return NULL;
+}
+
+static pid_t sender_start(char **argv, int *fd)
+{
+	int p[2];
+	pid_t pid;
+
+	if (pipe(p) < 0)
+		return -1;
+	pid = fork();
+	if (pid == 0) {
+		dup2(p[0], STDIN_FILENO);
+		close(p[0]);
+		close(p[1]);
+		execvp(argv[0], argv);
+		errprint("Unable to run %s: %s\n", argv[0], strerror(errno));
+		_exit(127);
+	}
+	close(p[0]);
+	if (pid < 0) {
+		close(p[1]);
+		return -1;
+	}
+	*fd = p[1];
+	return pid;
+}
+
+static int capture_open(snd_pcm_t **pcm, const char *device, unsigned capture_ms)
+{
+	int rc;
+
+	if ((rc = snd_pcm_open(pcm, device, SND_PCM_STREAM_CAPTURE, SND_PCM_NONBLOCK)) < 0) {
+		errprint("Unable to open %s: %s\n", device, snd_strerror(rc));
+		return rc;
+	}
+	// no plug layer resampling: what the driver delivers is what we diff
+	if ((rc = snd_pcm_set_params(*pcm, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED,
+			1, DC_PCM_RATE, 0, capture_ms * 1000)) < 0) {
+		errprint("Unable to set up %s: %s\n", device, snd_strerror(rc));
+		snd_pcm_close(*pcm);
+		return rc;
+	}
+	return 0;
+}
+
+// records until cap_max samples are in or the time is up
+static int capture_run(struct bench_s *b, snd_pcm_t *pcm, unsigned long long until)
+{
+	snd_pcm_uframes_t buffer_size, period_size;
+	snd_pcm_sframes_t r;
+
+	snd_pcm_get_params(pcm, &buffer_size, &period_size);
+	snd_pcm_start(pcm);
+	while (b->cap_len < b->cap_max && monotonic_ns() < until && !stop_bench) {
+		snd_pcm_uframes_t want = b->cap_max - b->cap_len;
+
+		snd_pcm_wait(pcm, 100);
+		r = snd_pcm_readi(pcm, b->cap + b->cap_len, want < period_size ? want : period_size);
+		if (r == -EAGAIN)
+			continue;
+		if (r == -EPIPE) {
+			// an overrun loses audio, which the diff will show as a slip
+			b->xruns++;
+			snd_pcm_prepare(pcm);
+			snd_pcm_start(pcm);
+			continue;
+		}
+		if (r < 0 && snd_pcm_recover(pcm, r, 1) < 0) {
+			errprint("Capture failed: %s\n", snd_strerror(r));
+			return -1;
+		}
+		if (r <= 0)
+			continue;
+		b->cap_len += r;
+		b->reads[b->nreads].end = b->cap_len;
+		b->reads[b->nreads].t = monotonic_ns();
+		b->nreads++;
+	}
+	return 0;
+}
+
+// when the application got the sample at pos
+static unsigned long long read_time(const struct bench_s *b, unsigned long pos)
+{
+	unsigned long lo = 0, hi = b->nreads - 1, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (b->reads[mid].end > pos)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return b->reads[lo].t;
+}
+
+static void markers_find(struct bench_s *b)
+{
+	unsigned long i, j, best;
+	double c, cbest;
+	long id;
+
+	for (i = 0; i < b->markers; i++)
+		b->found[i] = -1;
+
+	for (i = 0; i + MARKER_SAMPLES <= b->cap_len; i++) {
+		if (!b->cap[i] || sync_corr(b->cap + i) < SYNC_THRESHOLD)
+			continue;
+		// the peak is within a chip or two of the first hit
+		best = i;
+		cbest = sync_corr(b->cap + i);
+		for (j = i + 1; j < i + 2 * CHIP_SAMPLES && j + MARKER_SAMPLES <= b->cap_len; j++) {
+			c = sync_corr(b->cap + j);
+			if (c > cbest) {
+				cbest = c;
+				best = j;
+			}
+		}
+		id = marker_read(b->cap + best);
+		if (id < 0 || id >= (long)b->markers)
+			continue;
+		if (b->found[id] >= 0)
+			b->duplicates++;
+		else
+			b->found[id] = best;
+		i = best + MARKER_SAMPLES - 1;
+	}
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+static double percentile(const double *sorted, unsigned n, double p)
+{
+	unsigned i = (unsigned)(p * (n - 1) + 0.5);
+	return sorted[i < n ? i : n - 1];
+}
+
+static void report(struct bench_s *b, FILE *csv)
+{
+	unsigned k, n = 0, prev = 0, have_prev = 0;
+	unsigned long segments = 0, exact = 0, altered = 0, slipped = 0, lost = 0;
+	unsigned long mismatches = 0, inserted = 0, dropped = 0;
+	int max_err = 0;
+	double *lat = malloc(b->markers * sizeof(double));
+	double mean = 0, sd = 0;
+
+	if (!lat)
+		return;
+	if (csv)
+		fprintf(csv, "marker,inject_ns,capture_pos,latency_ms\n");
+
+	for (k = 0; k < b->markers; k++) {
+		if (!b->inject_ns[k])
+			break;	// never sent
+		if (b->found[k] < 0) {
+			lost++;
+			continue;
+		}
+		lat[n] = (double)(long long)(read_time(b, b->found[k]) - b->inject_ns[k]) / 1e6;
+		if (csv)
+			fprintf(csv, "%u,%llu,%ld,%.3f\n", k, b->inject_ns[k], b->found[k], lat[n]);
+		mean += lat[n];
+		n++;
+
+		// sample accurate diff of the audio since the previous marker
+		if (have_prev && prev == k - 1) {
+			unsigned long s = b->first + (unsigned long)prev * b->interval;
+			unsigned long c = b->found[prev], len = b->interval, j;
+			long slip = (b->found[k] - b->found[prev]) - (long)b->interval;
+			unsigned long bad = 0;
+
+			segments++;
+			if (slip) {
+				slipped++;
+				if (slip > 0)
+					inserted += slip;
+				else
+					dropped += -slip;
+			} else {
+				for (j = 0; j < len; j++) {
+					int err = abs(b->cap[c + j] - b->src[s + j]);
+					if (err) {
+						bad++;
+						if (err > max_err)
+							max_err = err;
+					}
+				}
+				if (bad) {
+					altered++;
+					mismatches += bad;
+				} else {
+					exact++;
+				}
+			}
+		}
+		prev = k;
+		have_prev = 1;
+	}
+	printf("markers: %u sent, %u found, %lu lost, %lu duplicate\n", k, n, lost, b->duplicates);
+	printf("capture: %lu frames in %lu reads, %lu xruns\n", b->cap_len, b->nreads, b->xruns);
+	if (!n) {
+		printf("no markers found: is the sender feeding the card that is recorded?\n");
+		free(lat);
+		return;
+	}
+
+	mean /= n;
+	for (k = 0; k < n; k++)
+		sd += (lat[k] - mean) * (lat[k] - mean);
+	sd = sqrt(sd / n);
+	qsort(lat, n, sizeof(double), cmp_double);
+	printf("latency (ms): min %.2f mean %.2f p50 %.2f p90 %.2f p99 %.2f max %.2f\n",
+		lat[0], mean, percentile(lat, n, 0.5), percentile(lat, n, 0.9), percentile(lat, n, 0.99), lat[n - 1]);
+	printf("jitter (ms): sd %.2f, p99-p50 %.2f, max-min %.2f\n",
+		sd, percentile(lat, n, 0.99) - percentile(lat, n, 0.5), lat[n - 1] - lat[0]);
+	printf("diff: %lu segments of %u samples, %lu bit exact, %lu altered (%lu samples, max |err| %d), "
+		"%lu slipped (%lu samples inserted, %lu dropped)\n",
+		segments, b->interval, exact, altered, mismatches, max_err, slipped, inserted, dropped);
+	printf("dropouts: %lu\n", lost + slipped + b->xruns);
+	printf("RESULT p50_ms=%.2f p99_ms=%.2f max_ms=%.2f jitter_sd_ms=%.2f lost=%lu slipped=%lu "
+		"altered=%lu exact=%lu xruns=%lu\n",
+		percentile(lat, n, 0.5), percentile(lat, n, 0.99), lat[n - 1], sd, lost, slipped,
+		altered, exact, b->xruns);
+	free(lat);
+}
+
+static void usage(const char *prog)
+{
+	errprint("Usage: %s [-D <device>] [--source <pcm>] [--seconds <s>] [--marker-ms <ms>]\n", prog);
+	errprint("          [--capture-ms <ms>] [--csv <file>] [-- <sender> <args> ...]\n");
+	errprint("  -D            capture device (default hw:1,0)\n");
+	errprint("  --source      S16LE 16kHz mono audio to send, looped (default zAudio.s16le.16000.pcm)\n");
+	errprint("  --seconds     length of the stream (default 10)\n");
+	errprint("  --marker-ms   time between markers (default 200)\n");
+	errprint("  --capture-ms  ALSA buffer of the recording side (default 40, periods a quarter)\n");
+	errprint("  --csv         per marker latencies\n");
+	errprint("  sender        reads the stream on stdin (default ./a.out --frame-ms 10 -)\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static char *default_sender[] = { "./a.out", "--frame-ms", "10", "-", NULL };
+	char **sender = default_sender;
+	const char *device = "hw:1,0", *source = "zAudio.s16le.16000.pcm", *csv_path = NULL;
+	unsigned seconds = 10, marker_ms = 200, capture_ms = 40;
+	struct bench_s b = { .fd = -1 };
+	snd_pcm_t *pcm = NULL;
+	pthread_t writer;
+	int writing = 0, status, rc = 1, i;
+	pid_t pid = -1;
+	FILE *csv = NULL;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-D") == 0 && i + 1 < argc) {
+			device = argv[++i];
+		} else if (strcmp(argv[i], "--source") == 0 && i + 1 < argc) {
+			source = argv[++i];
+		} else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+			seconds = strtoul(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--marker-ms") == 0 && i + 1 < argc) {
+			marker_ms = strtoul(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--capture-ms") == 0 && i + 1 < argc) {
+			capture_ms = strtoul(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+			csv_path = argv[++i];
+		} else if (strcmp(argv[i], "--") == 0 && i + 1 < argc) {
+			sender = argv + i + 1;
+			break;
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	sync_init();
+	if (source_build(&b, source, seconds, marker_ms) < 0)
+		goto EARLY_OUT;
+	b.cap_max = b.src_len + (unsigned long)TAIL_MS * DC_PCM_RATE / 1000;
+	b.cap = malloc(b.cap_max * sizeof(short));
+	// a read returns at least one frame
+	b.reads = malloc(b.cap_max * sizeof(*b.reads));
+	b.found = malloc(b.markers * sizeof(*b.found));
+	if (!b.cap || !b.reads || !b.found) {
+		errprint("Out of memory\n");
+		goto EARLY_OUT;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	if (capture_open(&pcm, device, capture_ms) < 0)
+		goto EARLY_OUT;
+
+	pid = sender_start(sender, &b.fd);
+	if (pid < 0) {
+		errprint("Unable to start the sender\n");
+		goto EARLY_OUT;
+	}
+	if (pthread_create(&writer, NULL, writer_thread, &b)) {
+		errprint("Unable to start the writer thread\n");
+		goto EARLY_OUT;
+	}
+	writing = 1;
+
+	printf("%u markers every %ums over %us, recording %s\n", b.markers, marker_ms, seconds, device);
+	fflush(stdout);
+	if (capture_run(&b, pcm, monotonic_ns() + (seconds * 1000ULL + TAIL_MS) * 1000000ULL) < 0)
+		goto EARLY_OUT;
+
+	stop_bench = 1;
+	pthread_join(writer, NULL);
+	writing = 0;
+
+	if (csv_path && !(csv = fopen(csv_path, "w")))
+		errprint("Unable to write %s\n", csv_path);
+	markers_find(&b);
+	report(&b, csv);
+	rc = 0;
+
+EARLY_OUT:
+	stop_bench = 1;
+	if (writing)
+		pthread_join(writer, NULL);
+	if (b.fd >= 0)
+		close(b.fd);
+	if (pid > 0)
+		waitpid(pid, &status, 0);
+	if (pcm)
+		snd_pcm_close(pcm);
+	if (csv)
+		fclose(csv);
+	free(b.src);
+	free(b.inject_ns);
+	free(b.cap);
+	free(b.reads);
+	free(b.found);
+	return rc;
+}
@@ -0,0 +1,309 @@
+/*
+ *  minivosc signal processing: fixed-point, kernel independent.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ */
+#ifdef __KERNEL__
+#include <linux/string.h>
+#else
+#include <string.h>
+#endif
+
+#include "minivosc-dsp.h"
+#include "minivosc-pp-table.h"
+
+/*
+ * Drift estimator tuning, per update (one capture tick):
+ *  - fill level EMA with weight 1/8
+ *  - proportional term 1 ppm per byte of error (10ms @16kHz -> 320 ppm)
+ *  - integral term 1 ppm per 256 byte-ticks of error
+ */
+#define DRIFT_AVG_SHIFT   3
+#define DRIFT_KI_DIV      256
+
+static s32 clamp_s32(s32 v, s32 lo, s32 hi)
+{
+	return v < lo ? lo : v > hi ? hi : v;
+}
+
+void minivosc_drift_reset(struct minivosc_drift *d)
+{
+	memset(d, 0, sizeof(*d));
+}
+
+s32 minivosc_drift_update(struct minivosc_drift *d, u32 fill, u32 target)
+{
+	s32 err;
+
+	if (!d->ready) {
+		d->avg = (s32)fill << 4;
+		d->ready = 1;
+	}
+	d->avg += (((s32)fill << 4) - d->avg) >> DRIFT_AVG_SHIFT;
+
+	err = (d->avg >> 4) - (s32)target;
+
+	// keep the integral within what the output can use (anti-windup)
+	d->integ = clamp_s32(d->integ + err,
+	                     -MINIVOSC_DRIFT_MAX_PPM * DRIFT_KI_DIV,
+	                     MINIVOSC_DRIFT_MAX_PPM * DRIFT_KI_DIV);
+	d->est_ppm = d->integ / DRIFT_KI_DIV;
+
+	d->ppm = clamp_s32(err + d->est_ppm, -MINIVOSC_DRIFT_MAX_PPM, MINIVOSC_DRIFT_MAX_PPM);
+	return d->ppm;
+}
+
+void minivosc_rs_reset(struct minivosc_rs *rs)
+{
+	rs->step = MINIVOSC_RS_ONE;
+	rs->phase = 0;
+	rs->prev = 0;
+}
+
+void minivosc_rs_set_ppm(struct minivosc_rs *rs, s32 ppm)
+{
+	// 2^24 / 10^6 = 16.777, |ppm| <= 5000 keeps this within s32
+	rs->step = MINIVOSC_RS_ONE + ppm * 16777 / 1000;
+}
+
+unsigned int minivosc_rs_run(struct minivosc_rs *rs, const s16 *in, unsigned int in_len,
+                             unsigned int *in_used, s16 *out, unsigned int out_len)
+{
+	unsigned int used = 0, produced = 0;
+	u32 phase = rs->phase;
+	s32 prev = rs->prev;
+
+	for (;;) {
+		s32 next;
+
+		// step past whole input samples
+		while (phase >= MINIVOSC_RS_ONE) {
+			if (used == in_len)
+				goto out;
+			prev = in[used++];
+			phase -= MINIVOSC_RS_ONE;
+		}
+		if (produced == out_len || used == in_len)
+			break;
+
+		// (next - prev) fits 17 bits, the Q15 fraction 15: no overflow
+		next = in[used];
+		out[produced++] = (s16)(prev + (((next - prev) * (s32)(phase >> (MINIVOSC_RS_SHIFT - 15))) >> 15));
+		phase += rs->step;
+	}
+
+out:
+	rs->phase = phase;
+	rs->prev = (s16)prev;
+	*in_used = used;
+	return produced;
+}
+
+static unsigned int gcd_u32(unsigned int a, unsigned int b)
+{
+	while (b) {
+		unsigned int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+unsigned int minivosc_pp_coef_len(unsigned int in_rate, unsigned int out_rate, unsigned int quality)
+{
+	if (!in_rate || out_rate <= in_rate || quality > MINIVOSC_PP_QUALITY_MAX)
+		return 0;
+	return out_rate / gcd_u32(out_rate, in_rate) * minivosc_pp_tables[quality].taps;
+}
+
+void minivosc_pp_init(struct minivosc_pp *pp, unsigned int in_rate, unsigned int out_rate,
+                      unsigned int quality, s16 *coef)
+{
+	const s16 *h = minivosc_pp_tables[quality].h;
+	unsigned int g = gcd_u32(out_rate, in_rate);
+	unsigned int p, k;
+
+	pp->L = out_rate / g;
+	pp->M = in_rate / g;
+	pp->taps = minivosc_pp_tables[quality].taps;
+	pp->coef = coef;
+
+	// phase p is p/L past the newest input: tap k sits at k + p/L on the
+	// prototype, interpolated linearly between its points
+	for (p = 0; p < pp->L; p++) {
+		s16 *c = coef + p * pp->taps;
+		s32 sum = 0, scaled = 0;
+		unsigned int peak = 0;
+
+		for (k = 0; k < pp->taps; k++) {
+			u32 x = (k * pp->L + p) * MINIVOSC_PP_OS;
+			u32 i = x / pp->L, frac = x % pp->L;
+
+			c[k] = (s16)(h[i] + (h[i + 1] - h[i]) * (s32)frac / (s32)pp->L);
+			sum += c[k];
+			if (c[k] > c[peak])
+				peak = k;
+		}
+
+		// exactly unity gain in every phase, or the phase pattern shows up as a tone
+		if (sum <= 0)
+			continue;
+		for (k = 0; k < pp->taps; k++) {
+			c[k] = (s16)((s32)c[k] * 32768 / sum);
+			scaled += c[k];
+		}
+		c[peak] += (s16)(32768 - scaled);
+	}
+
+	minivosc_pp_reset(pp);
+}
+
+void minivosc_pp_reset(struct minivosc_pp *pp)
+{
+	// the first output waits for the first input
+	pp->acc = pp->L;
+	pp->pos = 0;
+	memset(pp->hist, 0, sizeof(pp->hist));
+}
+
+unsigned int minivosc_pp_run(struct minivosc_pp *pp, const s16 *in, unsigned int in_len,
+                             unsigned int *in_used, s16 *out, unsigned int out_len)
+{
+	unsigned int used = 0, produced = 0, k;
+	unsigned int taps = pp->taps, acc = pp->acc, pos = pp->pos;
+
+	for (;;) {
+		const s16 *win, *c;
+		s64 y = 1 << 14;
+
+		// push the inputs this output needs
+		while (acc >= pp->L) {
+			if (used == in_len)
+				goto out;
+			pos = (pos ? pos : taps) - 1;
+			pp->hist[pos] = pp->hist[pos + taps] = in[used++];
+			acc -= pp->L;
+		}
+		if (produced == out_len)
+			break;
+
+		// win[k] is k samples older than the newest
+		win = pp->hist + pos;
+		c = pp->coef + acc * taps;
+		for (k = 0; k < taps; k++)
+			y += (s32)win[k] * c[k];
+		y >>= 15;
+		out[produced++] = (s16)(y > 32767 ? 32767 : y < -32768 ? -32768 : y);
+		acc += pp->M;
+	}
+
+out:
+	pp->acc = acc;
+	pp->pos = pos;
+	*in_used = used;
+	return produced;
+}
+
+void minivosc_plc_reset(struct minivosc_plc *plc)
+{
+	memset(plc, 0, sizeof(*plc));
+}
+
+// lag with the smallest average magnitude difference over the last 10ms
+static unsigned int minivosc_plc_pitch(const s16 *hist)
+{
+	const s16 *win = hist + MINIVOSC_PLC_HIST - 160;
+	unsigned int lag, i, best_lag = MINIVOSC_PLC_MAX_LAG;
+	u32 best = ~0U;
+
+	for (lag = MINIVOSC_PLC_MIN_LAG; lag <= MINIVOSC_PLC_MAX_LAG; lag++) {
+		const s16 *past = win - lag;
+		u32 amdf = 0;
+
+		// every other sample is plenty for a pitch estimate
+		for (i = 0; i < 160; i += 2) {
+			s32 d = win[i] - past[i];
+			amdf += d < 0 ? -d : d;
+		}
+		if (amdf < best) {
+			best = amdf;
+			best_lag = lag;
+		}
+	}
+
+	return best_lag;
+}
+
+static s16 minivosc_plc_next(struct minivosc_plc *plc)
+{
+	s32 v = plc->hist[MINIVOSC_PLC_HIST - plc->period + plc->idx];
+
+	if (++plc->idx == plc->period)
+		plc->idx = 0;
+
+	if (plc->hold)
+		plc->hold--;
+	else if (plc->gain > plc->gain_step)
+		plc->gain -= plc->gain_step;
+	else
+		plc->gain = 0;
+
+	plc->lost++;
+	return (s16)((v * plc->gain) >> 15);
+}
+
+void minivosc_plc_conceal(struct minivosc_plc *plc, s16 *out, unsigned int n,
+                          unsigned int hold, unsigned int fade)
+{
+	unsigned int i;
+
+	// new loss event
+	if (plc->lost == 0 || plc->xfade) {
+		plc->period = minivosc_plc_pitch(plc->hist);
+		plc->idx = 0;
+		plc->lost = 0;
+		plc->xfade = 0;
+		plc->hold = hold;
+		plc->gain = 1 << 15;
+		plc->gain_step = fade ? ((1 << 15) + fade - 1) / fade : 1 << 15;
+	}
+
+	// faded out completely, nothing left to synthesize
+	if (!plc->hold && !plc->gain) {
+		memset(out, 0, n * sizeof(s16));
+		plc->lost += n;
+		return;
+	}
+
+	for (i = 0; i < n; i++)
+		out[i] = minivosc_plc_next(plc);
+}
+
+void minivosc_plc_good(struct minivosc_plc *plc, s16 *pcm, unsigned int n)
+{
+	unsigned int i = 0;
+
+	// fade from the concealment into the real signal
+	if (plc->lost) {
+		for (; i < n && plc->xfade < MINIVOSC_PLC_XFADE; i++, plc->xfade++) {
+			s32 w = plc->xfade + 1;
+			s32 c = minivosc_plc_next(plc);
+
+			pcm[i] = (s16)((pcm[i] * w + c * (MINIVOSC_PLC_XFADE - w)) >> MINIVOSC_PLC_XFADE_SHIFT);
+		}
+		if (plc->xfade == MINIVOSC_PLC_XFADE) {
+			plc->lost = 0;
+			plc->xfade = 0;
+		}
+	}
+
+	if (n >= MINIVOSC_PLC_HIST) {
+		memcpy(plc->hist, pcm + n - MINIVOSC_PLC_HIST, sizeof(plc->hist));
+	} else {
+		memmove(plc->hist, plc->hist + n, (MINIVOSC_PLC_HIST - n) * sizeof(s16));
+		memcpy(plc->hist + MINIVOSC_PLC_HIST - n, pcm, n * sizeof(s16));
+	}
+}
@@ -0,0 +1,139 @@
+/*
+ *  minivosc signal processing: fixed-point, kernel independent.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ */
+#ifndef MINIVOSC_DSP_H
+#define MINIVOSC_DSP_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+typedef uint32_t u32;
+#endif
+
+/*
+ * Clock drift estimator: a PI controller on the smoothed jitter buffer
+ * fill level. A positive correction means the sender runs fast and we
+ * should consume slightly more than one input sample per output sample.
+ */
+#define MINIVOSC_DRIFT_MAX_PPM 5000 /* +-0.5% */
+
+struct minivosc_drift
+{
+	s32 avg;		/* smoothed fill level, bytes << 4 */
+	s32 integ;		/* accumulated fill error */
+	s32 est_ppm;		/* integral part: sender clock relative to ours */
+	s32 ppm;		/* correction currently applied */
+	unsigned int ready;	/* avg has been seeded */
+};
+
+void minivosc_drift_reset(struct minivosc_drift *d);
+
+/* feed one fill level sample (bytes), returns the new correction in ppm */
+s32 minivosc_drift_update(struct minivosc_drift *d, u32 fill, u32 target);
+
+/*
+ * Adaptive resampler for S16 mono: linear interpolation with a Q24 phase
+ * accumulator, for ratios within a fraction of a percent of 1.
+ */
+#define MINIVOSC_RS_SHIFT 24
+#define MINIVOSC_RS_ONE   (1U << MINIVOSC_RS_SHIFT)
+
+struct minivosc_rs
+{
+	u32 step;		/* input samples per output sample, Q24 */
+	u32 phase;		/* position past 'prev', Q24 */
+	s16 prev;		/* last consumed input sample */
+};
+
+void minivosc_rs_reset(struct minivosc_rs *rs);
+void minivosc_rs_set_ppm(struct minivosc_rs *rs, s32 ppm);
+
+/*
+ * Produce up to out_len samples from in[0 .. in_len). Returns the samples
+ * written to out and stores the input samples consumed in *in_used.
+ */
+unsigned int minivosc_rs_run(struct minivosc_rs *rs, const s16 *in, unsigned int in_len,
+                             unsigned int *in_used, s16 *out, unsigned int out_len);
+
+/*
+ * Polyphase resampler for S16 mono by a fixed ratio L/M in lowest terms
+ * (16000 -> 44100 is 441/160), for rates above the input rate. Each of
+ * the L output phases has its own FIR, taken from one of the prototype
+ * lowpass filters in minivosc-pp-table.h when the stream is set up, so
+ * the per sample work is a single dot product over 'taps' inputs.
+ */
+#define MINIVOSC_PP_OS       64	/* prototype filter points per input sample */
+#define MINIVOSC_PP_TAPS_MAX 32
+#define MINIVOSC_PP_QUALITY_MAX 2	/* 0: 8 taps, 1: 16 taps, 2: 32 taps */
+
+struct minivosc_pp
+{
+	const s16 *coef;		/* L phases of 'taps' Q15 coefficients */
+	unsigned int L, M;
+	unsigned int taps;
+	unsigned int acc;		/* the next output lies acc/L input samples past the newest one, once acc < L */
+	unsigned int pos;		/* newest sample in hist */
+	s16 hist[2 * MINIVOSC_PP_TAPS_MAX];	/* delay line, stored twice so a window never wraps */
+};
+
+/* number of coefficients minivosc_pp_init() needs, 0: ratio not supported */
+unsigned int minivosc_pp_coef_len(unsigned int in_rate, unsigned int out_rate, unsigned int quality);
+
+/* build the phase filters into coef (minivosc_pp_coef_len() entries) and reset */
+void minivosc_pp_init(struct minivosc_pp *pp, unsigned int in_rate, unsigned int out_rate,
+                      unsigned int quality, s16 *coef);
+void minivosc_pp_reset(struct minivosc_pp *pp);
+
+/* input samples needed to produce out_len more samples */
+static inline unsigned int minivosc_pp_need(const struct minivosc_pp *pp, unsigned int out_len)
+{
+	return out_len ? (pp->acc + (out_len - 1) * pp->M) / pp->L : 0;
+}
+
+/* same contract as minivosc_rs_run() */
+unsigned int minivosc_pp_run(struct minivosc_pp *pp, const s16 *in, unsigned int in_len,
+                             unsigned int *in_used, s16 *out, unsigned int out_len);
+
+/*
+ * Packet loss concealment for S16 mono: repeats the last pitch period of
+ * the good audio, holds it at full level for 'hold' samples, fades it to
+ * silence over 'fade' samples, and crossfades back when audio resumes.
+ * The pitch search (AMDF) runs once per loss event.
+ */
+#define MINIVOSC_PLC_HIST     480	/* 30ms @16kHz of history */
+#define MINIVOSC_PLC_MIN_LAG   40	/* 400Hz */
+#define MINIVOSC_PLC_MAX_LAG  240	/* 66Hz */
+#define MINIVOSC_PLC_XFADE_SHIFT 6
+#define MINIVOSC_PLC_XFADE    (1 << MINIVOSC_PLC_XFADE_SHIFT)
+
+struct minivosc_plc
+{
+	s16 hist[MINIVOSC_PLC_HIST];	/* last good samples, oldest first */
+	unsigned int period;		/* repetition period of this event */
+	unsigned int idx;		/* position in the repeated period */
+	unsigned int lost;		/* samples generated in this event, 0: none */
+	unsigned int hold;		/* samples left at full gain */
+	s32 gain;			/* Q15 */
+	s32 gain_step;			/* Q15 per sample while fading */
+	unsigned int xfade;		/* crossfade samples done after resuming */
+};
+
+void minivosc_plc_reset(struct minivosc_plc *plc);
+
+/* good audio was written to pcm: crossfade it in if we were concealing, then remember it */
+void minivosc_plc_good(struct minivosc_plc *plc, s16 *pcm, unsigned int n);
+
+/* write n samples of concealment to out */
+void minivosc_plc_conceal(struct minivosc_plc *plc, s16 *out, unsigned int n,
+                          unsigned int hold, unsigned int fade);
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ *  minivosc fill engine: writes audio into the ALSA dma ring buffer.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ */
+#ifdef __KERNEL__
+#include <linux/string.h>
+#include <asm/byteorder.h>
+#define minivosc_le32(x) cpu_to_le32(x)
+#else
+#include <string.h>
+#include <endian.h>
+#define minivosc_le32(x) htole32(x)
+#endif
+
+#include "minivosc-fill.h"
+
+void minivosc_dma_init(struct minivosc_dma *dma, void *area, unsigned int size, const u8 *silence)
+{
+	unsigned int i;
+
+	dma->area = area;
+	dma->size = size;
+	dma->pos = 0;
+
+	memcpy(dma->silence, silence, sizeof(dma->silence));
+	dma->silence_zero = 1;
+	for (i = 0; i < sizeof(dma->silence); i++) {
+		if (dma->silence[i])
+			dma->silence_zero = 0;
+	}
+}
+
+void minivosc_dma_copy(struct minivosc_dma *dma, const void *src, unsigned int len)
+{
+	unsigned int first;
+
+	if (len == 0)
+		return;
+
+	first = dma->size - dma->pos;
+	if (first > len)
+		first = len;
+
+	memcpy(dma->area + dma->pos, src, first);
+	if (len > first)
+		memcpy(dma->area, (const char *)src + first, len - first);
+
+	dma->pos += len;
+	if (dma->pos >= dma->size)
+		dma->pos -= dma->size;
+}
+
+// pos is sample aligned and the pattern period divides 8, so every
+// segment can start at silence[0]
+static void minivosc_dma_pattern(struct minivosc_dma *dma, char *dst, unsigned int len)
+{
+	if (dma->silence_zero) {
+		memset(dst, 0, len);
+		return;
+	}
+
+	while (len >= sizeof(dma->silence)) {
+		memcpy(dst, dma->silence, sizeof(dma->silence));
+		dst += sizeof(dma->silence);
+		len -= sizeof(dma->silence);
+	}
+	memcpy(dst, dma->silence, len);
+}
+
+void minivosc_dma_silence(struct minivosc_dma *dma, unsigned int len)
+{
+	unsigned int first;
+
+	// a length beyond one buffer would only overwrite itself
+	if (len > dma->size)
+		len = dma->size;
+	if (len == 0)
+		return;
+
+	first = dma->size - dma->pos;
+	if (first > len)
+		first = len;
+
+	minivosc_dma_pattern(dma, dma->area + dma->pos, first);
+	if (len > first)
+		minivosc_dma_pattern(dma, dma->area, len - first);
+
+	dma->pos += len;
+	if (dma->pos >= dma->size)
+		dma->pos -= dma->size;
+}
+
+void minivosc_convert(void *dst, const s16 *src, unsigned int frames,
+                      enum minivosc_fmt fmt, unsigned int channels)
+{
+	u32 *d = dst;
+	unsigned int i;
+
+	switch (fmt) {
+	case MINIVOSC_FMT_S16:
+		if (channels == 1) {
+			memcpy(dst, src, frames * sizeof(s16));
+			return;
+		}
+		for (i = 0; i < frames; i++) {
+			u32 v = (u16)src[i];
+			d[i] = minivosc_le32(v | v << 16);
+		}
+		break;
+
+	case MINIVOSC_FMT_U16:
+		if (channels == 1) {
+			u16 *h = dst;
+
+			// two samples per word, unless the buffers are not word aligned
+			i = 0;
+			if (((unsigned long)dst | (unsigned long)src) & 3) {
+				for (; i < frames; i++)
+					h[i] = (u16)src[i] ^ 0x8000;
+				return;
+			}
+			for (; i + 1 < frames; i += 2)
+				d[i / 2] = *(const u32 *)(src + i) ^ 0x80008000;
+			if (i < frames)
+				h[i] = (u16)src[i] ^ 0x8000;
+			return;
+		}
+		for (i = 0; i < frames; i++) {
+			u32 v = (u16)src[i] ^ 0x8000;
+			d[i] = minivosc_le32(v | v << 16);
+		}
+		break;
+
+	case MINIVOSC_FMT_S32:
+		if (channels == 1) {
+			for (i = 0; i < frames; i++)
+				d[i] = minivosc_le32((u32)(u16)src[i] << 16);
+			return;
+		}
+		for (i = 0; i < frames; i++) {
+			u32 v = minivosc_le32((u32)(u16)src[i] << 16);
+			d[2 * i] = v;
+			d[2 * i + 1] = v;
+		}
+		break;
+	}
+}
@@ -0,0 +1,83 @@
+/*
+ *  minivosc fill engine: writes audio into the ALSA dma ring buffer.
+ *
+ *  Kernel independent, so it can also be built and benchmarked in
+ *  userspace (see fill-bench.c, "make fillbench").
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ */
+#ifndef MINIVOSC_FILL_H
+#define MINIVOSC_FILL_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef int16_t  s16;
+typedef uint32_t u32;
+#endif
+
+/*
+ * The destination ring, normally runtime->dma_area. pos is a byte offset
+ * and always a multiple of the sample size.
+ */
+struct minivosc_dma
+{
+	char *area;
+	unsigned int size;		/* bytes */
+	unsigned int pos;		/* next byte to write */
+	u8 silence[8];			/* one or more samples of silence, repeated */
+	unsigned int silence_zero;	/* silence is all zero bytes */
+};
+
+/* 'silence' holds 8 bytes of silence in the stream format */
+void minivosc_dma_init(struct minivosc_dma *dma, void *area, unsigned int size, const u8 *silence);
+
+/* copy 'len' bytes at pos, split in at most two memcpy() around the wrap */
+void minivosc_dma_copy(struct minivosc_dma *dma, const void *src, unsigned int len);
+
+/* bytes writable at pos before the wrap, for producers writing in place */
+static inline unsigned int minivosc_dma_span(const struct minivosc_dma *dma)
+{
+	return dma->size - dma->pos;
+}
+
+/* account for 'len' bytes written in place at pos (len <= span) */
+static inline void minivosc_dma_advance(struct minivosc_dma *dma, unsigned int len)
+{
+	dma->pos += len;
+	if (dma->pos >= dma->size)
+		dma->pos -= dma->size;
+}
+
+/* write 'len' bytes of silence at pos */
+void minivosc_dma_silence(struct minivosc_dma *dma, unsigned int len);
+
+/*
+ * Format/channel conversion from the S16LE mono the engine works in to
+ * what the application opened. Each source sample becomes one or two
+ * 32 bit stores, so no per-byte work is done.
+ */
+enum minivosc_fmt
+{
+	MINIVOSC_FMT_S16,	/* S16_LE */
+	MINIVOSC_FMT_U16,	/* U16_LE */
+	MINIVOSC_FMT_S32,	/* S32_LE */
+};
+
+/* bytes of one output frame */
+static inline unsigned int minivosc_convert_frame_bytes(enum minivosc_fmt fmt, unsigned int channels)
+{
+	return (fmt == MINIVOSC_FMT_S32 ? 4 : 2) * channels;
+}
+
+/* convert 'frames' mono S16 samples; channels is 1 or 2 */
+void minivosc_convert(void *dst, const s16 *src, unsigned int frames,
+                      enum minivosc_fmt fmt, unsigned int channels);
+
+#endif
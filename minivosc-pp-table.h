@@ -0,0 +1,382 @@
+/* generated by pp-table-gen.c (make pptables), do not edit */
+
+/* quality 0: 8 taps, cutoff 0.80, beta 5.0 */
+static const s16 minivosc_pp_h0[513] = {
+	   -56,    -56,    -55,    -54,    -53,    -51,    -49,    -47,    -43,    -40,
+	   -36,    -31,    -26,    -20,    -14,     -7,      0,      8,     17,     26,
+	    35,     46,     57,     68,     81,     93,    107,    121,    135,    151,
+	   166,    182,    199,    216,    234,    252,    271,    290,    309,    328,
+	   348,    368,    388,    409,    429,    450,    470,    490,    511,    531,
+	   550,    570,    589,    608,    626,    643,    660,    676,    691,    706,
+	   719,    732,    743,    753,    762,    770,    776,    781,    784,    785,
+	   785,    783,    779,    774,    766,    756,    744,    730,    714,    695,
+	   674,    651,    626,    597,    567,    534,    498,    460,    419,    376,
+	   330,    281,    230,    176,    120,     61,      0,    -64,   -130,   -198,
+	  -269,   -342,   -418,   -495,   -574,   -656,   -739,   -824,   -910,   -998,
+	 -1088,  -1178,  -1270,  -1362,  -1455,  -1549,  -1644,  -1738,  -1833,  -1928,
+	 -2022,  -2116,  -2209,  -2302,  -2393,  -2483,  -2571,  -2658,  -2742,  -2824,
+	 -2904,  -2981,  -3056,  -3127,  -3194,  -3258,  -3318,  -3373,  -3425,  -3471,
+	 -3513,  -3549,  -3580,  -3606,  -3625,  -3639,  -3646,  -3646,  -3639,  -3626,
+	 -3605,  -3577,  -3541,  -3497,  -3445,  -3385,  -3317,  -3239,  -3154,  -3059,
+	 -2955,  -2842,  -2720,  -2589,  -2448,  -2297,  -2137,  -1967,  -1788,  -1598,
+	 -1399,  -1190,   -972,   -743,   -505,   -257,      0,    267,    543,    829,
+	  1124,   1428,   1741,   2063,   2394,   2732,   3079,   3435,   3797,   4168,
+	  4546,   4930,   5322,   5719,   6123,   6533,   6948,   7369,   7794,   8223,
+	  8656,   9094,   9534,   9977,  10422,  10870,  11319,  11769,  12220,  12671,
+	 13122,  13573,  14022,  14470,  14915,  15358,  15798,  16235,  16668,  17096,
+	 17520,  17938,  18351,  18757,  19157,  19550,  19935,  20312,  20681,  21041,
+	 21392,  21733,  22064,  22385,  22695,  22994,  23281,  23557,  23821,  24072,
+	 24310,  24536,  24748,  24946,  25131,  25302,  25459,  25601,  25729,  25842,
+	 25941,  26024,  26092,  26146,  26184,  26207,  26214,  26207,  26184,  26146,
+	 26092,  26024,  25941,  25842,  25729,  25601,  25459,  25302,  25131,  24946,
+	 24748,  24536,  24310,  24072,  23821,  23557,  23281,  22994,  22695,  22385,
+	 22064,  21733,  21392,  21041,  20681,  20312,  19935,  19550,  19157,  18757,
+	 18351,  17938,  17520,  17096,  16668,  16235,  15798,  15358,  14915,  14470,
+	 14022,  13573,  13122,  12671,  12220,  11769,  11319,  10870,  10422,   9977,
+	  9534,   9094,   8656,   8223,   7794,   7369,   6948,   6533,   6123,   5719,
+	  5322,   4930,   4546,   4168,   3797,   3435,   3079,   2732,   2394,   2063,
+	  1741,   1428,   1124,    829,    543,    267,      0,   -257,   -505,   -743,
+	  -972,  -1190,  -1399,  -1598,  -1788,  -1967,  -2137,  -2297,  -2448,  -2589,
+	 -2720,  -2842,  -2955,  -3059,  -3154,  -3239,  -3317,  -3385,  -3445,  -3497,
+	 -3541,  -3577,  -3605,  -3626,  -3639,  -3646,  -3646,  -3639,  -3625,  -3606,
+	 -3580,  -3549,  -3513,  -3471,  -3425,  -3373,  -3318,  -3258,  -3194,  -3127,
+	 -3056,  -2981,  -2904,  -2824,  -2742,  -2658,  -2571,  -2483,  -2393,  -2302,
+	 -2209,  -2116,  -2022,  -1928,  -1833,  -1738,  -1644,  -1549,  -1455,  -1362,
+	 -1270,  -1178,  -1088,   -998,   -910,   -824,   -739,   -656,   -574,   -495,
+	  -418,   -342,   -269,   -198,   -130,    -64,      0,     61,    120,    176,
+	   230,    281,    330,    376,    419,    460,    498,    534,    567,    597,
+	   626,    651,    674,    695,    714,    730,    744,    756,    766,    774,
+	   779,    783,    785,    785,    784,    781,    776,    770,    762,    753,
+	   743,    732,    719,    706,    691,    676,    660,    643,    626,    608,
+	   589,    570,    550,    531,    511,    490,    470,    450,    429,    409,
+	   388,    368,    348,    328,    309,    290,    271,    252,    234,    216,
+	   199,    182,    166,    151,    135,    121,    107,     93,     81,     68,
+	    57,     46,     35,     26,     17,      8,      0,     -7,    -14,    -20,
+	   -26,    -31,    -36,    -40,    -43,    -47,    -49,    -51,    -53,    -54,
+	   -55,    -56,    -56,
+};
+
+/* quality 1: 16 taps, cutoff 0.88, beta 7.0 */
+static const s16 minivosc_pp_h1[1025] = {
+	    -1,     -1,      0,      0,      0,      1,      1,      2,      2,      3,
+	     4,      4,      5,      6,      7,      7,      8,      9,     10,     11,
+	    12,     13,     14,     15,     16,     17,     18,     19,     20,     21,
+	    22,     23,     25,     26,     27,     28,     29,     30,     31,     32,
+	    33,     33,     34,     35,     36,     36,     37,     37,     37,     38,
+	    38,     38,     38,     38,     38,     37,     37,     36,     36,     35,
+	    34,     33,     32,     30,     29,     27,     25,     23,     21,     19,
+	    16,     14,     11,      8,      5,      2,     -1,     -5,     -8,    -12,
+	   -16,    -20,    -24,    -28,    -32,    -37,    -41,    -46,    -50,    -55,
+	   -60,    -65,    -69,    -74,    -79,    -84,    -89,    -94,    -99,   -103,
+	  -108,   -113,   -117,   -122,   -126,   -130,   -134,   -138,   -142,   -145,
+	  -148,   -151,   -154,   -157,   -159,   -161,   -163,   -164,   -165,   -166,
+	  -167,   -167,   -166,   -166,   -164,   -163,   -161,   -159,   -156,   -153,
+	  -149,   -145,   -140,   -135,   -129,   -123,   -117,   -110,   -103,    -95,
+	   -86,    -78,    -69,    -59,    -49,    -38,    -27,    -16,     -4,      8,
+	    20,     33,     46,     59,     73,     87,    101,    115,    130,    144,
+	   159,    174,    189,    204,    219,    233,    248,    263,    277,    292,
+	   306,    320,    333,    347,    360,    372,    384,    396,    407,    417,
+	   427,    437,    445,    453,    460,    467,    472,    477,    481,    484,
+	   485,    486,    487,    485,    483,    480,    476,    471,    464,    457,
+	   448,    438,    427,    415,    401,    387,    371,    354,    336,    317,
+	   296,    275,    252,    228,    204,    178,    151,    123,     94,     65,
+	    34,      3,    -29,    -62,    -95,   -130,   -164,   -199,   -235,   -271,
+	  -307,   -343,   -380,   -417,   -454,   -490,   -527,   -563,   -599,   -635,
+	  -670,   -704,   -738,   -771,   -804,   -835,   -866,   -895,   -924,   -951,
+	  -976,  -1001,  -1023,  -1045,  -1064,  -1082,  -1098,  -1113,  -1125,  -1135,
+	 -1144,  -1150,  -1153,  -1155,  -1154,  -1151,  -1146,  -1138,  -1128,  -1115,
+	 -1100,  -1082,  -1061,  -1038,  -1012,   -984,   -953,   -919,   -883,   -845,
+	  -803,   -760,   -713,   -665,   -614,   -560,   -505,   -447,   -387,   -325,
+	  -261,   -195,   -127,    -58,     13,     85,    159,    234,    310,    388,
+	   466,    544,    624,    703,    783,    863,    943,   1023,   1103,   1181,
+	  1260,   1337,   1413,   1488,   1562,   1634,   1704,   1772,   1838,   1902,
+	  1964,   2023,   2078,   2131,   2181,   2228,   2271,   2310,   2346,   2378,
+	  2405,   2429,   2448,   2462,   2472,   2478,   2478,   2474,   2464,   2449,
+	  2430,   2405,   2374,   2339,   2298,   2251,   2199,   2142,   2079,   2011,
+	  1937,   1858,   1774,   1684,   1590,   1489,   1384,   1274,   1159,   1040,
+	   915,    787,    654,    517,    376,    231,     82,    -69,   -224,   -382,
+	  -542,   -705,   -870,  -1037,  -1205,  -1375,  -1545,  -1716,  -1888,  -2060,
+	 -2231,  -2402,  -2572,  -2740,  -2907,  -3072,  -3234,  -3394,  -3551,  -3704,
+	 -3853,  -3998,  -4139,  -4275,  -4405,  -4530,  -4648,  -4761,  -4866,  -4964,
+	 -5055,  -5138,  -5213,  -5280,  -5337,  -5386,  -5425,  -5454,  -5473,  -5482,
+	 -5481,  -5468,  -5444,  -5409,  -5363,  -5305,  -5234,  -5152,  -5057,  -4950,
+	 -4830,  -4697,  -4552,  -4394,  -4222,  -4038,  -3840,  -3630,  -3406,  -3170,
+	 -2920,  -2657,  -2381,  -2093,  -1792,  -1478,  -1152,   -814,   -463,   -101,
+	   273,    658,   1055,   1462,   1880,   2308,   2746,   3193,   3650,   4115,
+	  4589,   5070,   5559,   6056,   6559,   7068,   7583,   8103,   8627,   9156,
+	  9689,  10224,  10762,  11303,  11844,  12387,  12929,  13472,  14014,  14554,
+	 15092,  15628,  16160,  16689,  17213,  17732,  18246,  18753,  19254,  19748,
+	 20233,  20711,  21179,  21638,  22087,  22525,  22952,  23368,  23771,  24162,
+	 24540,  24904,  25255,  25591,  25913,  26219,  26510,  26785,  27044,  27287,
+	 27513,  27721,  27913,  28087,  28243,  28381,  28501,  28603,  28687,  28752,
+	 28799,  28827,  28836,  28827,  28799,  28752,  28687,  28603,  28501,  28381,
+	 28243,  28087,  27913,  27721,  27513,  27287,  27044,  26785,  26510,  26219,
+	 25913,  25591,  25255,  24904,  24540,  24162,  23771,  23368,  22952,  22525,
+	 22087,  21638,  21179,  20711,  20233,  19748,  19254,  18753,  18246,  17732,
+	 17213,  16689,  16160,  15628,  15092,  14554,  14014,  13472,  12929,  12387,
+	 11844,  11303,  10762,  10224,   9689,   9156,   8627,   8103,   7583,   7068,
+	  6559,   6056,   5559,   5070,   4589,   4115,   3650,   3193,   2746,   2308,
+	  1880,   1462,   1055,    658,    273,   -101,   -463,   -814,  -1152,  -1478,
+	 -1792,  -2093,  -2381,  -2657,  -2920,  -3170,  -3406,  -3630,  -3840,  -4038,
+	 -4222,  -4394,  -4552,  -4697,  -4830,  -4950,  -5057,  -5152,  -5234,  -5305,
+	 -5363,  -5409,  -5444,  -5468,  -5481,  -5482,  -5473,  -5454,  -5425,  -5386,
+	 -5337,  -5280,  -5213,  -5138,  -5055,  -4964,  -4866,  -4761,  -4648,  -4530,
+	 -4405,  -4275,  -4139,  -3998,  -3853,  -3704,  -3551,  -3394,  -3234,  -3072,
+	 -2907,  -2740,  -2572,  -2402,  -2231,  -2060,  -1888,  -1716,  -1545,  -1375,
+	 -1205,  -1037,   -870,   -705,   -542,   -382,   -224,    -69,     82,    231,
+	   376,    517,    654,    787,    915,   1040,   1159,   1274,   1384,   1489,
+	  1590,   1684,   1774,   1858,   1937,   2011,   2079,   2142,   2199,   2251,
+	  2298,   2339,   2374,   2405,   2430,   2449,   2464,   2474,   2478,   2478,
+	  2472,   2462,   2448,   2429,   2405,   2378,   2346,   2310,   2271,   2228,
+	  2181,   2131,   2078,   2023,   1964,   1902,   1838,   1772,   1704,   1634,
+	  1562,   1488,   1413,   1337,   1260,   1181,   1103,   1023,    943,    863,
+	   783,    703,    624,    544,    466,    388,    310,    234,    159,     85,
+	    13,    -58,   -127,   -195,   -261,   -325,   -387,   -447,   -505,   -560,
+	  -614,   -665,   -713,   -760,   -803,   -845,   -883,   -919,   -953,   -984,
+	 -1012,  -1038,  -1061,  -1082,  -1100,  -1115,  -1128,  -1138,  -1146,  -1151,
+	 -1154,  -1155,  -1153,  -1150,  -1144,  -1135,  -1125,  -1113,  -1098,  -1082,
+	 -1064,  -1045,  -1023,  -1001,   -976,   -951,   -924,   -895,   -866,   -835,
+	  -804,   -771,   -738,   -704,   -670,   -635,   -599,   -563,   -527,   -490,
+	  -454,   -417,   -380,   -343,   -307,   -271,   -235,   -199,   -164,   -130,
+	   -95,    -62,    -29,      3,     34,     65,     94,    123,    151,    178,
+	   204,    228,    252,    275,    296,    317,    336,    354,    371,    387,
+	   401,    415,    427,    438,    448,    457,    464,    471,    476,    480,
+	   483,    485,    487,    486,    485,    484,    481,    477,    472,    467,
+	   460,    453,    445,    437,    427,    417,    407,    396,    384,    372,
+	   360,    347,    333,    320,    306,    292,    277,    263,    248,    233,
+	   219,    204,    189,    174,    159,    144,    130,    115,    101,     87,
+	    73,     59,     46,     33,     20,      8,     -4,    -16,    -27,    -38,
+	   -49,    -59,    -69,    -78,    -86,    -95,   -103,   -110,   -117,   -123,
+	  -129,   -135,   -140,   -145,   -149,   -153,   -156,   -159,   -161,   -163,
+	  -164,   -166,   -166,   -167,   -167,   -166,   -165,   -164,   -163,   -161,
+	  -159,   -157,   -154,   -151,   -148,   -145,   -142,   -138,   -134,   -130,
+	  -126,   -122,   -117,   -113,   -108,   -103,    -99,    -94,    -89,    -84,
+	   -79,    -74,    -69,    -65,    -60,    -55,    -50,    -46,    -41,    -37,
+	   -32,    -28,    -24,    -20,    -16,    -12,     -8,     -5,     -1,      2,
+	     5,      8,     11,     14,     16,     19,     21,     23,     25,     27,
+	    29,     30,     32,     33,     34,     35,     36,     36,     37,     37,
+	    38,     38,     38,     38,     38,     38,     37,     37,     37,     36,
+	    36,     35,     34,     33,     33,     32,     31,     30,     29,     28,
+	    27,     26,     25,     23,     22,     21,     20,     19,     18,     17,
+	    16,     15,     14,     13,     12,     11,     10,      9,      8,      7,
+	     7,      6,      5,      4,      4,      3,      2,      2,      1,      1,
+	     0,      0,      0,     -1,     -1,
+};
+
+/* quality 2: 32 taps, cutoff 0.92, beta 9.0 */
+static const s16 minivosc_pp_h2[2049] = {
+	     0,      0,      1,      1,      1,      1,      1,      1,      1,      1,
+	     1,      1,      1,      1,      1,      1,      1,      1,      1,      1,
+	     1,      1,      1,      1,      1,      1,      1,      1,      1,      1,
+	     1,      1,      1,      1,      1,      1,      1,      1,      1,      1,
+	     1,      1,      1,      1,      1,      1,      0,      0,      0,      0,
+	     0,      0,      0,      0,      0,     -1,     -1,     -1,     -1,     -1,
+	    -1,     -2,     -2,     -2,     -2,     -2,     -2,     -3,     -3,     -3,
+	    -3,     -3,     -3,     -4,     -4,     -4,     -4,     -4,     -4,     -4,
+	    -5,     -5,     -5,     -5,     -5,     -5,     -5,     -5,     -5,     -5,
+	    -6,     -6,     -6,     -6,     -6,     -6,     -6,     -5,     -5,     -5,
+	    -5,     -5,     -5,     -5,     -5,     -4,     -4,     -4,     -4,     -4,
+	    -3,     -3,     -3,     -2,     -2,     -2,     -1,     -1,     -1,      0,
+	     0,      1,      1,      1,      2,      2,      3,      3,      4,      4,
+	     5,      5,      6,      6,      7,      7,      8,      8,      9,      9,
+	    10,     10,     11,     11,     12,     12,     13,     13,     13,     14,
+	    14,     14,     15,     15,     15,     15,     16,     16,     16,     16,
+	    16,     16,     16,     16,     16,     16,     16,     15,     15,     15,
+	    14,     14,     14,     13,     13,     12,     11,     11,     10,      9,
+	     9,      8,      7,      6,      5,      4,      3,      2,      1,      0,
+	    -1,     -2,     -3,     -4,     -5,     -7,     -8,     -9,    -10,    -12,
+	   -13,    -14,    -15,    -17,    -18,    -19,    -20,    -21,    -23,    -24,
+	   -25,    -26,    -27,    -28,    -29,    -30,    -31,    -32,    -33,    -33,
+	   -34,    -35,    -35,    -36,    -36,    -37,    -37,    -37,    -37,    -37,
+	   -37,    -37,    -37,    -37,    -36,    -36,    -35,    -35,    -34,    -33,
+	   -32,    -31,    -30,    -29,    -28,    -27,    -25,    -24,    -22,    -20,
+	   -19,    -17,    -15,    -13,    -11,     -9,     -6,     -4,     -2,      1,
+	     3,      5,      8,     10,     13,     16,     18,     21,     23,     26,
+	    29,     31,     34,     36,     39,     42,     44,     46,     49,     51,
+	    53,     56,     58,     60,     62,     63,     65,     67,     68,     70,
+	    71,     72,     73,     74,     75,     75,     76,     76,     76,     76,
+	    76,     75,     75,     74,     73,     72,     71,     69,     68,     66,
+	    64,     62,     60,     57,     54,     52,     49,     45,     42,     39,
+	    35,     31,     27,     23,     19,     15,     11,      6,      2,     -3,
+	    -8,    -13,    -17,    -22,    -27,    -32,    -37,    -42,    -47,    -52,
+	   -57,    -62,    -67,    -72,    -77,    -81,    -86,    -90,    -95,    -99,
+	  -103,   -107,   -111,   -114,   -118,   -121,   -124,   -127,   -129,   -132,
+	  -134,   -136,   -137,   -139,   -140,   -140,   -141,   -141,   -141,   -141,
+	  -140,   -139,   -137,   -136,   -134,   -132,   -129,   -126,   -123,   -119,
+	  -115,   -111,   -107,   -102,    -97,    -91,    -86,    -80,    -74,    -67,
+	   -60,    -53,    -46,    -39,    -31,    -24,    -16,     -8,      1,      9,
+	    18,     26,     35,     44,     52,     61,     70,     79,     88,     96,
+	   105,    114,    122,    130,    139,    147,    154,    162,    169,    177,
+	   183,    190,    196,    202,    208,    213,    218,    223,    227,    230,
+	   234,    237,    239,    241,    242,    243,    244,    243,    243,    242,
+	   240,    238,    235,    232,    228,    224,    219,    213,    207,    201,
+	   194,    186,    178,    170,    161,    151,    141,    131,    120,    109,
+	    97,     85,     73,     60,     47,     34,     20,      7,     -7,    -21,
+	   -36,    -50,    -65,    -79,    -94,   -109,   -123,   -138,   -152,   -167,
+	  -181,   -195,   -209,   -223,   -236,   -249,   -262,   -274,   -286,   -297,
+	  -308,   -319,   -329,   -338,   -347,   -355,   -362,   -369,   -376,   -381,
+	  -386,   -390,   -393,   -396,   -397,   -398,   -398,   -397,   -396,   -393,
+	  -390,   -386,   -381,   -375,   -368,   -360,   -351,   -342,   -332,   -321,
+	  -309,   -296,   -282,   -268,   -253,   -237,   -221,   -204,   -186,   -167,
+	  -148,   -129,   -108,    -88,    -67,    -45,    -23,     -1,     22,     44,
+	    67,     90,    114,    137,    160,    184,    207,    230,    253,    275,
+	   298,    320,    342,    363,    383,    404,    423,    442,    460,    478,
+	   495,    511,    526,    540,    553,    565,    576,    586,    595,    603,
+	   610,    616,    620,    623,    625,    625,    624,    622,    619,    614,
+	   608,    600,    591,    581,    569,    557,    542,    527,    510,    492,
+	   472,    452,    430,    407,    383,    358,    331,    304,    276,    247,
+	   217,    186,    154,    122,     89,     55,     21,    -14,    -49,    -84,
+	  -119,   -155,   -191,   -227,   -263,   -299,   -334,   -369,   -404,   -439,
+	  -473,   -506,   -539,   -571,   -602,   -633,   -662,   -691,   -718,   -744,
+	  -769,   -792,   -815,   -835,   -855,   -872,   -888,   -903,   -915,   -926,
+	  -936,   -943,   -948,   -952,   -953,   -953,   -950,   -946,   -939,   -931,
+	  -920,   -908,   -893,   -876,   -858,   -837,   -814,   -789,   -763,   -734,
+	  -704,   -672,   -638,   -602,   -564,   -525,   -485,   -443,   -399,   -354,
+	  -308,   -261,   -212,   -163,   -112,    -61,     -9,     43,     97,    150,
+	   204,    258,    312,    366,    420,    474,    527,    580,    633,    684,
+	   735,    785,    834,    882,    928,    973,   1017,   1058,   1099,   1137,
+	  1173,   1208,   1240,   1270,   1298,   1324,   1346,   1367,   1385,   1400,
+	  1412,   1422,   1429,   1432,   1433,   1431,   1426,   1418,   1407,   1393,
+	  1375,   1355,   1332,   1305,   1276,   1243,   1208,   1169,   1128,   1084,
+	  1037,    987,    935,    880,    823,    763,    701,    637,    570,    502,
+	   432,    360,    287,    212,    135,     58,    -21,   -100,   -180,   -261,
+	  -342,   -423,   -505,   -586,   -668,   -748,   -829,   -908,   -987,  -1064,
+	 -1140,  -1215,  -1288,  -1359,  -1428,  -1495,  -1560,  -1622,  -1682,  -1739,
+	 -1793,  -1844,  -1892,  -1936,  -1977,  -2014,  -2048,  -2078,  -2103,  -2125,
+	 -2143,  -2156,  -2165,  -2169,  -2169,  -2165,  -2156,  -2142,  -2124,  -2101,
+	 -2074,  -2042,  -2005,  -1963,  -1917,  -1867,  -1812,  -1752,  -1688,  -1620,
+	 -1547,  -1470,  -1390,  -1305,  -1216,  -1124,  -1029,   -929,   -827,   -722,
+	  -614,   -503,   -390,   -274,   -156,    -37,     84,    207,    331,    456,
+	   581,    707,    833,    959,   1085,   1210,   1334,   1458,   1579,   1700,
+	  1818,   1934,   2048,   2159,   2267,   2371,   2473,   2570,   2664,   2753,
+	  2838,   2918,   2993,   3063,   3128,   3187,   3240,   3287,   3328,   3363,
+	  3391,   3413,   3428,   3436,   3436,   3430,   3417,   3396,   3368,   3332,
+	  3289,   3238,   3180,   3115,   3041,   2961,   2873,   2778,   2675,   2566,
+	  2449,   2325,   2195,   2058,   1914,   1765,   1609,   1447,   1280,   1107,
+	   930,    747,    560,    368,    173,    -26,   -228,   -434,   -642,   -852,
+	 -1063,  -1277,  -1491,  -1706,  -1921,  -2136,  -2351,  -2564,  -2776,  -2986,
+	 -3193,  -3398,  -3599,  -3797,  -3990,  -4179,  -4362,  -4540,  -4712,  -4877,
+	 -5035,  -5186,  -5330,  -5464,  -5591,  -5708,  -5815,  -5913,  -6000,  -6077,
+	 -6142,  -6197,  -6239,  -6269,  -6287,  -6292,  -6284,  -6263,  -6228,  -6180,
+	 -6117,  -6040,  -5949,  -5843,  -5723,  -5588,  -5437,  -5272,  -5092,  -4896,
+	 -4685,  -4460,  -4219,  -3962,  -3691,  -3405,  -3104,  -2789,  -2458,  -2114,
+	 -1755,  -1383,   -996,   -596,   -184,    242,    680,   1131,   1593,   2067,
+	  2551,   3046,   3552,   4066,   4590,   5123,   5664,   6212,   6768,   7330,
+	  7898,   8471,   9049,   9631,  10216,  10805,  11396,  11988,  12581,  13175,
+	 13768,  14360,  14950,  15538,  16123,  16704,  17281,  17852,  18418,  18977,
+	 19530,  20074,  20611,  21138,  21655,  22163,  22659,  23144,  23617,  24077,
+	 24524,  24957,  25376,  25780,  26169,  26542,  26899,  27239,  27562,  27868,
+	 28156,  28425,  28676,  28908,  29120,  29314,  29487,  29641,  29775,  29888,
+	 29981,  30053,  30105,  30136,  30147,  30136,  30105,  30053,  29981,  29888,
+	 29775,  29641,  29487,  29314,  29120,  28908,  28676,  28425,  28156,  27868,
+	 27562,  27239,  26899,  26542,  26169,  25780,  25376,  24957,  24524,  24077,
+	 23617,  23144,  22659,  22163,  21655,  21138,  20611,  20074,  19530,  18977,
+	 18418,  17852,  17281,  16704,  16123,  15538,  14950,  14360,  13768,  13175,
+	 12581,  11988,  11396,  10805,  10216,   9631,   9049,   8471,   7898,   7330,
+	  6768,   6212,   5664,   5123,   4590,   4066,   3552,   3046,   2551,   2067,
+	  1593,   1131,    680,    242,   -184,   -596,   -996,  -1383,  -1755,  -2114,
+	 -2458,  -2789,  -3104,  -3405,  -3691,  -3962,  -4219,  -4460,  -4685,  -4896,
+	 -5092,  -5272,  -5437,  -5588,  -5723,  -5843,  -5949,  -6040,  -6117,  -6180,
+	 -6228,  -6263,  -6284,  -6292,  -6287,  -6269,  -6239,  -6197,  -6142,  -6077,
+	 -6000,  -5913,  -5815,  -5708,  -5591,  -5464,  -5330,  -5186,  -5035,  -4877,
+	 -4712,  -4540,  -4362,  -4179,  -3990,  -3797,  -3599,  -3398,  -3193,  -2986,
+	 -2776,  -2564,  -2351,  -2136,  -1921,  -1706,  -1491,  -1277,  -1063,   -852,
+	  -642,   -434,   -228,    -26,    173,    368,    560,    747,    930,   1107,
+	  1280,   1447,   1609,   1765,   1914,   2058,   2195,   2325,   2449,   2566,
+	  2675,   2778,   2873,   2961,   3041,   3115,   3180,   3238,   3289,   3332,
+	  3368,   3396,   3417,   3430,   3436,   3436,   3428,   3413,   3391,   3363,
+	  3328,   3287,   3240,   3187,   3128,   3063,   2993,   2918,   2838,   2753,
+	  2664,   2570,   2473,   2371,   2267,   2159,   2048,   1934,   1818,   1700,
+	  1579,   1458,   1334,   1210,   1085,    959,    833,    707,    581,    456,
+	   331,    207,     84,    -37,   -156,   -274,   -390,   -503,   -614,   -722,
+	  -827,   -929,  -1029,  -1124,  -1216,  -1305,  -1390,  -1470,  -1547,  -1620,
+	 -1688,  -1752,  -1812,  -1867,  -1917,  -1963,  -2005,  -2042,  -2074,  -2101,
+	 -2124,  -2142,  -2156,  -2165,  -2169,  -2169,  -2165,  -2156,  -2143,  -2125,
+	 -2103,  -2078,  -2048,  -2014,  -1977,  -1936,  -1892,  -1844,  -1793,  -1739,
+	 -1682,  -1622,  -1560,  -1495,  -1428,  -1359,  -1288,  -1215,  -1140,  -1064,
+	  -987,   -908,   -829,   -748,   -668,   -586,   -505,   -423,   -342,   -261,
+	  -180,   -100,    -21,     58,    135,    212,    287,    360,    432,    502,
+	   570,    637,    701,    763,    823,    880,    935,    987,   1037,   1084,
+	  1128,   1169,   1208,   1243,   1276,   1305,   1332,   1355,   1375,   1393,
+	  1407,   1418,   1426,   1431,   1433,   1432,   1429,   1422,   1412,   1400,
+	  1385,   1367,   1346,   1324,   1298,   1270,   1240,   1208,   1173,   1137,
+	  1099,   1058,   1017,    973,    928,    882,    834,    785,    735,    684,
+	   633,    580,    527,    474,    420,    366,    312,    258,    204,    150,
+	    97,     43,     -9,    -61,   -112,   -163,   -212,   -261,   -308,   -354,
+	  -399,   -443,   -485,   -525,   -564,   -602,   -638,   -672,   -704,   -734,
+	  -763,   -789,   -814,   -837,   -858,   -876,   -893,   -908,   -920,   -931,
+	  -939,   -946,   -950,   -953,   -953,   -952,   -948,   -943,   -936,   -926,
+	  -915,   -903,   -888,   -872,   -855,   -835,   -815,   -792,   -769,   -744,
+	  -718,   -691,   -662,   -633,   -602,   -571,   -539,   -506,   -473,   -439,
+	  -404,   -369,   -334,   -299,   -263,   -227,   -191,   -155,   -119,    -84,
+	   -49,    -14,     21,     55,     89,    122,    154,    186,    217,    247,
+	   276,    304,    331,    358,    383,    407,    430,    452,    472,    492,
+	   510,    527,    542,    557,    569,    581,    591,    600,    608,    614,
+	   619,    622,    624,    625,    625,    623,    620,    616,    610,    603,
+	   595,    586,    576,    565,    553,    540,    526,    511,    495,    478,
+	   460,    442,    423,    404,    383,    363,    342,    320,    298,    275,
+	   253,    230,    207,    184,    160,    137,    114,     90,     67,     44,
+	    22,     -1,    -23,    -45,    -67,    -88,   -108,   -129,   -148,   -167,
+	  -186,   -204,   -221,   -237,   -253,   -268,   -282,   -296,   -309,   -321,
+	  -332,   -342,   -351,   -360,   -368,   -375,   -381,   -386,   -390,   -393,
+	  -396,   -397,   -398,   -398,   -397,   -396,   -393,   -390,   -386,   -381,
+	  -376,   -369,   -362,   -355,   -347,   -338,   -329,   -319,   -308,   -297,
+	  -286,   -274,   -262,   -249,   -236,   -223,   -209,   -195,   -181,   -167,
+	  -152,   -138,   -123,   -109,    -94,    -79,    -65,    -50,    -36,    -21,
+	    -7,      7,     20,     34,     47,     60,     73,     85,     97,    109,
+	   120,    131,    141,    151,    161,    170,    178,    186,    194,    201,
+	   207,    213,    219,    224,    228,    232,    235,    238,    240,    242,
+	   243,    243,    244,    243,    242,    241,    239,    237,    234,    230,
+	   227,    223,    218,    213,    208,    202,    196,    190,    183,    177,
+	   169,    162,    154,    147,    139,    130,    122,    114,    105,     96,
+	    88,     79,     70,     61,     52,     44,     35,     26,     18,      9,
+	     1,     -8,    -16,    -24,    -31,    -39,    -46,    -53,    -60,    -67,
+	   -74,    -80,    -86,    -91,    -97,   -102,   -107,   -111,   -115,   -119,
+	  -123,   -126,   -129,   -132,   -134,   -136,   -137,   -139,   -140,   -141,
+	  -141,   -141,   -141,   -140,   -140,   -139,   -137,   -136,   -134,   -132,
+	  -129,   -127,   -124,   -121,   -118,   -114,   -111,   -107,   -103,    -99,
+	   -95,    -90,    -86,    -81,    -77,    -72,    -67,    -62,    -57,    -52,
+	   -47,    -42,    -37,    -32,    -27,    -22,    -17,    -13,     -8,     -3,
+	     2,      6,     11,     15,     19,     23,     27,     31,     35,     39,
+	    42,     45,     49,     52,     54,     57,     60,     62,     64,     66,
+	    68,     69,     71,     72,     73,     74,     75,     75,     76,     76,
+	    76,     76,     76,     75,     75,     74,     73,     72,     71,     70,
+	    68,     67,     65,     63,     62,     60,     58,     56,     53,     51,
+	    49,     46,     44,     42,     39,     36,     34,     31,     29,     26,
+	    23,     21,     18,     16,     13,     10,      8,      5,      3,      1,
+	    -2,     -4,     -6,     -9,    -11,    -13,    -15,    -17,    -19,    -20,
+	   -22,    -24,    -25,    -27,    -28,    -29,    -30,    -31,    -32,    -33,
+	   -34,    -35,    -35,    -36,    -36,    -37,    -37,    -37,    -37,    -37,
+	   -37,    -37,    -37,    -37,    -36,    -36,    -35,    -35,    -34,    -33,
+	   -33,    -32,    -31,    -30,    -29,    -28,    -27,    -26,    -25,    -24,
+	   -23,    -21,    -20,    -19,    -18,    -17,    -15,    -14,    -13,    -12,
+	   -10,     -9,     -8,     -7,     -5,     -4,     -3,     -2,     -1,      0,
+	     1,      2,      3,      4,      5,      6,      7,      8,      9,      9,
+	    10,     11,     11,     12,     13,     13,     14,     14,     14,     15,
+	    15,     15,     16,     16,     16,     16,     16,     16,     16,     16,
+	    16,     16,     16,     15,     15,     15,     15,     14,     14,     14,
+	    13,     13,     13,     12,     12,     11,     11,     10,     10,      9,
+	     9,      8,      8,      7,      7,      6,      6,      5,      5,      4,
+	     4,      3,      3,      2,      2,      1,      1,      1,      0,      0,
+	    -1,     -1,     -1,     -2,     -2,     -2,     -3,     -3,     -3,     -4,
+	    -4,     -4,     -4,     -4,     -5,     -5,     -5,     -5,     -5,     -5,
+	    -5,     -5,     -6,     -6,     -6,     -6,     -6,     -6,     -6,     -5,
+	    -5,     -5,     -5,     -5,     -5,     -5,     -5,     -5,     -5,     -4,
+	    -4,     -4,     -4,     -4,     -4,     -4,     -3,     -3,     -3,     -3,
+	    -3,     -3,     -2,     -2,     -2,     -2,     -2,     -2,     -1,     -1,
+	    -1,     -1,     -1,     -1,      0,      0,      0,      0,      0,      0,
+	     0,      0,      0,      1,      1,      1,      1,      1,      1,      1,
+	     1,      1,      1,      1,      1,      1,      1,      1,      1,      1,
+	     1,      1,      1,      1,      1,      1,      1,      1,      1,      1,
+	     1,      1,      1,      1,      1,      1,      1,      1,      1,      1,
+	     1,      1,      1,      1,      1,      1,      1,      0,      0,
+};
+
+static const struct {
+	unsigned int taps;
+	const s16 *h;
+} minivosc_pp_tables[] = {
+	{  8, minivosc_pp_h0 },
+	{ 16, minivosc_pp_h1 },
+	{ 32, minivosc_pp_h2 },
+};
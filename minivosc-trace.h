@@ -0,0 +1,99 @@
+/*
+ * Tracepoints for the audio path of the droidcam virtual mic.
+ *
+ *  ~$ echo 1 > /sys/kernel/debug/tracing/events/minivosc/enable
+ *  ~$ cat /sys/kernel/debug/tracing/trace_pipe
+ *
+ * All times are CLOCK_MONOTONIC in ns, so arrival, timer and period
+ * events of one card can be lined up directly.
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM minivosc
+
+#if !defined(_MINIVOSC_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _MINIVOSC_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/ktime.h>
+
+// a netlink chunk was handed to the jitter buffer; rc < 0: dropped
+TRACE_EVENT(minivosc_chunk_rx,
+	TP_PROTO(int card, unsigned int sequence, unsigned int len, int rc),
+	TP_ARGS(card, sequence, len, rc),
+	TP_STRUCT__entry(
+		__field(int, card)
+		__field(unsigned int, sequence)
+		__field(unsigned int, len)
+		__field(int, rc)
+		__field(s64, arrival)
+	),
+	TP_fast_assign(
+		__entry->card = card;
+		__entry->sequence = sequence;
+		__entry->len = len;
+		__entry->rc = rc;
+		__entry->arrival = ktime_to_ns(ktime_get());
+	),
+	TP_printk("card=%d seq=%u len=%u rc=%d arrival=%lld",
+		__entry->card, __entry->sequence, __entry->len, __entry->rc, __entry->arrival)
+);
+
+// the capture clock fired
+TRACE_EVENT(minivosc_timer_fire,
+	TP_PROTO(int card, ktime_t scheduled, ktime_t actual),
+	TP_ARGS(card, scheduled, actual),
+	TP_STRUCT__entry(
+		__field(int, card)
+		__field(s64, scheduled)
+		__field(s64, actual)
+	),
+	TP_fast_assign(
+		__entry->card = card;
+		__entry->scheduled = ktime_to_ns(scheduled);
+		__entry->actual = ktime_to_ns(actual);
+	),
+	TP_printk("card=%d scheduled=%lld actual=%lld late=%lld",
+		__entry->card, __entry->scheduled, __entry->actual,
+		__entry->actual - __entry->scheduled)
+);
+
+// bytes written to the dma area in one tick, pos is where the next one goes
+TRACE_EVENT(minivosc_fill,
+	TP_PROTO(int card, unsigned int bytes, unsigned int pos),
+	TP_ARGS(card, bytes, pos),
+	TP_STRUCT__entry(
+		__field(int, card)
+		__field(unsigned int, bytes)
+		__field(unsigned int, pos)
+	),
+	TP_fast_assign(
+		__entry->card = card;
+		__entry->bytes = bytes;
+		__entry->pos = pos;
+	),
+	TP_printk("card=%d bytes=%u pos=%u", __entry->card, __entry->bytes, __entry->pos)
+);
+
+// right before snd_pcm_period_elapsed()
+TRACE_EVENT(minivosc_period_elapsed,
+	TP_PROTO(int card, unsigned int pos),
+	TP_ARGS(card, pos),
+	TP_STRUCT__entry(
+		__field(int, card)
+		__field(unsigned int, pos)
+	),
+	TP_fast_assign(
+		__entry->card = card;
+		__entry->pos = pos;
+	),
+	TP_printk("card=%d pos=%u", __entry->card, __entry->pos)
+);
+
+#endif /* _MINIVOSC_TRACE_H */
+
+// the header lives next to minivosc.c, not in include/trace/events
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE minivosc-trace
+#include <trace/define_trace.h>
@@ -42,12 +42,15 @@
 #if _DEBUG
 //# define dbg(format, arg...) printk(KERN_DEBUG __FILE__ ": " format "\n" , ## arg)
 # define dbg err
-# define dbg2 err
 #else
 # define dbg(...) /* */
-# define dbg2(...) /* */
 #endif
 
+/* Hot path messages go through dynamic debug, so they cost nothing unless
+ * switched on at runtime (the tracepoints in minivosc-trace.h are cheaper):
+ * echo 'module snd_minivosc +p' > /sys/kernel/debug/dynamic_debug/control */
+#define dbg2(format, arg...) pr_debug(format "\n" , ## arg)
+
 /* Here is our user defined breakpoint to */
 /* initiate communication with remote (k)gdb */
 /* don't use if not actually using kgdb */
@@ -58,19 +61,35 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/jiffies.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/time.h>
 #include <linux/wait.h>
 #include <linux/moduleparam.h>
 #include <linux/platform_device.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/rcupdate.h>
+#include <linux/seqlock.h>
+#include <linux/workqueue.h>
 #include <sound/core.h>
 #include <sound/control.h>
 #include <sound/pcm.h>
 #include <sound/initval.h>
+#include <sound/info.h>
 #include <linux/version.h>
 #include <net/genetlink.h>
 
 #include "genetlink-common.h"
+#include "minivosc-fill.h"
+#include "minivosc-dsp.h"
+
+#define CREATE_TRACE_POINTS
+#include "minivosc-trace.h"
 
 MODULE_AUTHOR("sdaau, dev47apps");
 MODULE_DESCRIPTION("droidcam virtual mic");
@@ -80,38 +99,248 @@ MODULE_SUPPORTED_DEVICE("{{ALSA,minivosc soundcard}}");
 static int index[SNDRV_CARDS] = SNDRV_DEFAULT_IDX;	/* Index 0-MAX */
 static char *id[SNDRV_CARDS] = SNDRV_DEFAULT_STR;	/* ID for this card */
 static int enable[SNDRV_CARDS] = {1, [1 ... (SNDRV_CARDS - 1)] = 0};
+static int jb_depth = 2;	/* chunks buffered before capture starts draining */
+static int timer_mode = 0;	/* 0 = jiffies timer_list, 1 = hrtimer */
+static int drift_comp = 1;	/* adapt to the sender's clock */
+static int plc_frames = 3;	/* conceal lost audio for this many frames, then fade out */
+static int pointer_interp = 1;	/* smooth pointer between fills */
+static int preroll_ms = 0;	/* audio kept while not capturing, delivered on start */
+static int period_ms_min = 5;	/* ALSA geometry limits, see minivosc_pcm_constraints */
+static int period_ms_max = 500;
+static int buffer_ms_max = 2000;
+static int period_pow2 = 0;	/* only offer power of two period sizes */
+static int rs_quality = 1;	/* polyphase resampler for rates above 16kHz, 0-2 */
+static int feedback_ms = 100;	/* DC_GENL_CMD_FEEDBACK interval, 0 = off */
+
+module_param_array(index, int, NULL, 0444);
+MODULE_PARM_DESC(index, "Index value for the DroidCam virtual mic soundcard.");
+module_param_array(id, charp, NULL, 0444);
+MODULE_PARM_DESC(id, "ID string for the DroidCam virtual mic soundcard.");
+module_param_array(enable, int, NULL, 0444);
+MODULE_PARM_DESC(enable, "Enable this virtual mic (one entry per card, routed by DC_GENL_ATTR_CARD).");
+module_param(jb_depth, int, 0644);
+MODULE_PARM_DESC(jb_depth, "Jitter buffer target depth in chunks (1-63).");
+module_param(timer_mode, int, 0644);
+MODULE_PARM_DESC(timer_mode, "Capture clock: 0 = jiffies timer (default), 1 = hrtimer on period boundaries.");
+module_param(drift_comp, int, 0644);
+MODULE_PARM_DESC(drift_comp, "Resample by up to +-0.5% to keep the jitter buffer at its target depth (default 1).");
+module_param(period_ms_min, int, 0444);
+MODULE_PARM_DESC(period_ms_min, "Shortest ALSA period in ms (1-1000, default 5).");
+module_param(period_ms_max, int, 0444);
+MODULE_PARM_DESC(period_ms_max, "Longest ALSA period in ms (default 500).");
+module_param(buffer_ms_max, int, 0444);
+MODULE_PARM_DESC(buffer_ms_max, "Largest ALSA buffer in ms (up to 10000, default 2000).");
+module_param(period_pow2, int, 0444);
+MODULE_PARM_DESC(period_pow2, "Only allow power of two period sizes in frames (default 0).");
+module_param(preroll_ms, int, 0644);
+MODULE_PARM_DESC(preroll_ms, "Keep this much recent audio while no capture runs and deliver up to a period of it on start (0-1000, default 0 = off).");
+module_param(pointer_interp, int, 0644);
+MODULE_PARM_DESC(pointer_interp, "Advance the pointer with time between fills instead of in whole batches (default 1).");
+module_param(plc_frames, int, 0644);
+MODULE_PARM_DESC(plc_frames, "Conceal lost or late frames by repeating the last pitch period, fading to silence over this many frames (0 = plain silence, default 3).");
+module_param(feedback_ms, int, 0644);
+MODULE_PARM_DESC(feedback_ms, "Multicast the jitter buffer state to senders this often while capturing (default 100, 0 = off).");
+module_param(rs_quality, int, 0644);
+MODULE_PARM_DESC(rs_quality, "Resampler quality for 32/44.1/48kHz streams: 0 = 8, 1 = 16 (default), 2 = 32 filter taps.");
 
 static struct platform_device *devices[SNDRV_CARDS];
 
 #define byte_pos(x) ((x) / HZ)
 #define frac_pos(x) ((x) * HZ)
 
-#define PERIODS_MAX    16
-#define PERIOD_BYTES 3200 /* 50ms @16KHz or 100ms @8KHZ */
-#define MAX_BUFFER (PERIODS_MAX * PERIOD_BYTES)
+// the period and buffer limits in the template are only a coarse bound,
+// the real ones depend on the rate and are set up in minivosc_pcm_constraints
+#define PERIODS_MAX    1024
+#define PERIOD_BYTES_MIN 16
+#define SAMPLE_BYTES_MAX 4 /* widest format we offer */
+#define MINIVOSC_STAGE_SAMPLES 2048 /* 16kHz input resampled per step, 128ms */
+#define MAX_BUFFER ((unsigned int)(buffer_ms_max * (minivosc_pcm_hw.rate_max / 1000) * minivosc_pcm_hw.channels_max * SAMPLE_BYTES_MAX))
+
+// link timestamps: the sender's capture time of the sample at the hw pointer
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0)
+#define MINIVOSC_INFO_TSTAMP ( SNDRV_PCM_INFO_HAS_LINK_ATIME | SNDRV_PCM_INFO_HAS_LINK_ABSOLUTE_ATIME )
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3,8,0)
+#define MINIVOSC_INFO_TSTAMP SNDRV_PCM_INFO_HAS_WALL_CLOCK
+#else
+#define MINIVOSC_INFO_TSTAMP 0
+#endif
 
 static struct snd_pcm_hardware minivosc_pcm_hw =
 {
-	.info = ( SNDRV_PCM_INFO_MMAP | SNDRV_PCM_INFO_MMAP_VALID | SNDRV_PCM_INFO_INTERLEAVED | SNDRV_PCM_INFO_BLOCK_TRANSFER ),
-	.formats          = SNDRV_PCM_FMTBIT_U16,
-	.rates            = SNDRV_PCM_RATE_8000|SNDRV_PCM_RATE_16000,
-	.rate_min         = 8000,  /* 16kBps */
-	.rate_max         = 16000, /* 32kBps */
+	.info = ( SNDRV_PCM_INFO_MMAP | SNDRV_PCM_INFO_MMAP_VALID | SNDRV_PCM_INFO_INTERLEAVED | SNDRV_PCM_INFO_BLOCK_TRANSFER |
+	          SNDRV_PCM_INFO_NO_PERIOD_WAKEUP | MINIVOSC_INFO_TSTAMP ),
+	/* S16_LE mono is what the sender delivers, the rest is converted in
+	 * minivosc_convert_out() */
+	.formats          = SNDRV_PCM_FMTBIT_S16_LE|SNDRV_PCM_FMTBIT_U16_LE|SNDRV_PCM_FMTBIT_S32_LE,
+	/* 16kHz is what the sender delivers, higher rates go through minivosc_pp */
+	.rates            = SNDRV_PCM_RATE_16000|SNDRV_PCM_RATE_32000|SNDRV_PCM_RATE_44100|SNDRV_PCM_RATE_48000,
+	.rate_min         = 16000, /* 32kBps */
+	.rate_max         = 48000,
+	.channels_min     = 1,
+	.channels_max     = 2,
+	.buffer_bytes_max = 0,	/* MAX_BUFFER, set in _open */
+	.period_bytes_min = PERIOD_BYTES_MIN,
+	.period_bytes_max = 0,	/* MAX_BUFFER / 2 */
+	.periods_min      = 2,
+	.periods_max      = PERIODS_MAX,
+};
+
+// the virtual speaker plays exactly what goes out on the wire, the plug
+// layer converts anything else
+static struct snd_pcm_hardware minivosc_playback_hw =
+{
+	/* the pointer moves a period at a time */
+	.info = ( SNDRV_PCM_INFO_MMAP | SNDRV_PCM_INFO_MMAP_VALID | SNDRV_PCM_INFO_INTERLEAVED | SNDRV_PCM_INFO_BLOCK_TRANSFER |
+	          SNDRV_PCM_INFO_BATCH ),
+	.formats          = SNDRV_PCM_FMTBIT_S16_LE,
+	.rates            = SNDRV_PCM_RATE_16000,
+	.rate_min         = DC_PCM_RATE,
+	.rate_max         = DC_PCM_RATE,
 	.channels_min     = 1,
 	.channels_max     = 1,
-	.buffer_bytes_max = MAX_BUFFER,
-	.period_bytes_min = PERIOD_BYTES,
-	.period_bytes_max = PERIOD_BYTES,
-	.periods_min      = 1,
+	.buffer_bytes_max = 0,	/* MAX_BUFFER, set in _open */
+	.period_bytes_min = PERIOD_BYTES_MIN,
+	.period_bytes_max = 0,	/* MAX_BUFFER / 2 */
+	.periods_min      = 2,
 	.periods_max      = PERIODS_MAX,
 };
 
+/*
+ * Jitter buffer: a bounded single-producer/single-consumer ring of chunks.
+ * The netlink handler is the only writer of 'head', the capture timer the
+ * only writer of 'tail', so no lock is needed between the two.
+ * Netlink handlers run in parallel, so producers take push_lock among
+ * themselves; it is per card and never touched by the timer.
+ */
+#define MINIVOSC_JB_SLOTS 64 /* must be a power of 2 */
+#define MINIVOSC_JB_MASK  (MINIVOSC_JB_SLOTS - 1)
+#define MINIVOSC_HIST_SIZE 32768 /* pre-roll history, ~1s; must be a power of 2 */
+
+// one received frame, legacy 100ms chunks and variable length frames alike
+struct minivosc_chunk
+{
+	unsigned sequence;
+	unsigned int len;		/* valid bytes in data */
+	s64 tstamp;			/* CLOCK_MONOTONIC ns of the first sample */
+	char data[DC_PCM_FRAME_MAX_LEN];
+};
+
+struct minivosc_jb
+{
+	struct minivosc_chunk *slots;
+	spinlock_t push_lock;		/* serializes producers */
+	unsigned int head;		/* next slot to write (producer) */
+	unsigned int tail;		/* next slot to read (consumer) */
+	unsigned int read_ofs;		/* bytes of the tail chunk already consumed (consumer) */
+	unsigned int last_len;		/* length of the last chunk (producer) */
+	unsigned int target;		/* depth to reach before draining (consumer) */
+	unsigned int primed;		/* target depth was reached (consumer) */
+	unsigned last_sequence;		/* last accepted sequence (producer) */
+	unsigned play_sequence;		/* last sequence handed to ALSA (consumer) */
+	/* pre-roll history, written by the producer while capture is stopped */
+	char *hist;
+	unsigned int hist_on;		/* capture stopped: record into hist */
+	unsigned int hist_head;		/* bytes ever written */
+	s64 hist_ts;			/* capture time right after the newest byte */
+	unsigned long hist_jiffies;	/* last write */
+	/* producer counters, under push_lock */
+	unsigned long chunks;		/* accepted */
+	unsigned long drops;		/* stale or duplicate sequence numbers */
+	unsigned long overruns;		/* ring full, incoming chunk discarded */
+	unsigned long rejects;		/* malformed frames */
+};
+
+/*
+ * Capture side statistics. Only the capture clock writes these, so they
+ * need no atomics; a reset from /proc bumps reset_gen and the clock
+ * clears them on its next tick. Producer counters live in the jitter
+ * buffer under its push_lock, which the producers take anyway.
+ */
+#define MINIVOSC_LATE_BUCKETS 9
+
+static const unsigned int minivosc_late_us[MINIVOSC_LATE_BUCKETS - 1] =
+	{ 50, 100, 250, 500, 1000, 2000, 5000, 10000 };
+
+struct minivosc_stats
+{
+	unsigned int reset_seen;	/* reset_gen this was last cleared for */
+	unsigned long underruns;	/* clock wanted data, source was empty */
+	unsigned long gaps;		/* sequence gaps seen by the consumer */
+	unsigned long lost;		/* chunks missing in those gaps */
+	unsigned long concealed;	/* samples synthesized */
+	unsigned long timer_fires;
+	unsigned long late[MINIVOSC_LATE_BUCKETS];	/* lateness histogram, see minivosc_late_us */
+	unsigned int late_max_us;
+	unsigned int depth_min;		/* jitter buffer depth in chunks, per tick */
+	unsigned int depth_max;
+	u64 depth_sum;
+	u64 bytes;			/* written to the dma area */
+};
+
+/*
+ * mmap ring transport: userspace writes straight into a vmalloc_user()
+ * area, the capture timer copies from there into the dma area.
+ * Layout and protocol are in genetlink-common.h.
+ */
+struct minivosc_ring
+{
+	void *area;			/* control page + data, mapped by userspace */
+	struct dc_ring_ctl_s *ctl;
+	char *data;
+	u32 tail;			/* our copy, ctl->tail is only published */
+	unsigned int active;		/* a producer has the device open */
+	unsigned long flags;		/* bit 0: open */
+	wait_queue_head_t wait;
+	char name[24];
+	struct miscdevice misc;
+};
+
+/*
+ * Virtual speaker: the playback substream of the card. An hrtimer keeps
+ * the nominal rate and only counts the periods that are due; a work item
+ * copies each out of the dma area as frames, multicasts them as
+ * DC_GENL_CMD_PLAYBACK, numbered and timestamped like the frames senders
+ * feed the capture side, and only then moves the hw pointer past them.
+ */
+struct minivosc_playback
+{
+	struct snd_pcm_substream *substream;
+	struct hrtimer timer;
+	ktime_t period_time;
+	unsigned int running;
+	atomic_t due;			/* periods played by the timer, not yet sent */
+	unsigned int pos;		/* hw pointer, bytes into the dma area */
+	unsigned int buffer_size;	/* bytes */
+	unsigned int period_size;	/* bytes */
+	s64 start_ts;			/* CLOCK_MONOTONIC ns the stream started playing */
+	u64 played;			/* bytes since start */
+	unsigned sequence;		/* of the last frame sent or skipped */
+	struct minivosc_chunk *frame;	/* staging, owned by the work */
+	unsigned long sent, drops;
+	struct work_struct work;
+};
+
+struct minivosc_device;
+
+/*
+ * The capture clock. Both implementations are set up in _open,
+ * timer_mode picks the one used for the stream.
+ */
+struct minivosc_timer_ops
+{
+	void (*start)(struct minivosc_device *mydev);
+	void (*stop)(struct minivosc_device *mydev);	/* may be called atomically */
+	void (*sync)(struct minivosc_device *mydev);	/* wait for a running callback */
+	void (*kick)(struct minivosc_device *mydev);	/* restart an idle clock, from a producer */
+};
+
 
 struct minivosc_device
 {
 	struct snd_card *card;
 	struct snd_pcm *pcm;
-	const struct minivosc_pcm_ops *timer_ops;
+	int dev_id;			/* platform device id, index into g_mydevs */
+	const struct minivosc_timer_ops *timer_ops;
 	/*
 	* we have only one substream, so all data in this struct
 	*/
@@ -129,19 +358,67 @@ struct minivosc_device
 	unsigned int period_size_frac;
 	unsigned long last_jiffies;
 	struct timer_list timer;
+	/* hrtimer clock */
+	struct hrtimer hrtimer;
+	ktime_t hr_base;		/* stream start time */
+	u64 hr_frames;			/* frames delivered since hr_base */
+	struct tasklet_struct period_tasklet;
+	/* idle: the clock stops when there is no producer, see minivosc_kick */
+	unsigned long idle;		/* bit 0: clock stopped, waiting for data */
+	unsigned int idle_periods;	/* hrtimer: periods in a row without data */
 	/* copied from struct loopback_pcm: */
 	struct snd_pcm_substream *substream;
-	unsigned int pcm_buffer_size;
-	unsigned int buf_pos;	/* position in buffer */
-	unsigned int silent_size;
-
-	// DroidCam PCM backbuffer
-	unsigned last_sequence;
-	struct dc_pcm_chunk_s back_buffer;
+	unsigned int pcm_buffer_size;	/* bytes of S16 mono, like all sizes above */
+	struct minivosc_dma dma;	/* dma area and position in it */
+	/* format conversion: the fill path always writes S16 mono, into 'shadow'
+	 * when the app opened anything else; see minivosc_convert_out */
+	s16 *shadow;
+	enum minivosc_fmt conv_fmt;
+	unsigned int conv_channels;
+	/* rate conversion: above 16kHz the fill path writes into 'stage' and
+	 * minivosc_stage_out() resamples that into dma; 'sink' is either */
+	struct minivosc_dma *sink;
+	struct minivosc_dma stage;
+	struct minivosc_pp pp;
+	s16 *pp_coef;			/* phase filters, NULL: no resampling */
+	s16 stage_buf[MINIVOSC_STAGE_SAMPLES];
+	/* clock drift compensation */
+	unsigned int drift_comp;
+	struct minivosc_drift drift;
+	struct minivosc_rs rs;
+	/* packet loss concealment */
+	unsigned int plc_frames;
+	struct minivosc_plc plc;
+	unsigned int plc_bytes;		/* concealment owed before the next chunk */
+	unsigned int padded;		/* source bytes underruns filled in since the last chunk started */
+
+	/* capture time of the audio at dma.pos, for delay and link timestamps */
+	seqcount_t ts_seq;		/* the clock writes, pointer/get_time_info read */
+	s64 next_ts;			/* CLOCK_MONOTONIC ns of the next sample we write, 0: unknown */
+	s64 first_ts;			/* ... of the first sample of the stream */
+	/* pointer interpolation, also under ts_seq */
+	unsigned int ptr_interp;
+	u64 written;			/* bytes written to the dma area this stream */
+	u64 ptr_base;			/* reported position at the last fill */
+	ktime_t ptr_time;		/* time of the last fill */
+
+	struct minivosc_stats stats;	/* written by the capture clock only */
+	unsigned int reset_gen;		/* bumped by writing "reset" to /proc/.../stats */
+	/* sender feedback: the clock schedules it, netlink can't be used from there */
+	struct work_struct fb_work;
+	unsigned long fb_next;		/* jiffies */
+
+	// DroidCam PCM jitter buffer (netlink -> timer)
+	struct minivosc_jb jb;
+	// mmap ring, used instead of the jitter buffer while open
+	struct minivosc_ring ring;
+	// virtual speaker
+	struct minivosc_playback pb;
 };
 
-// xxx: not sure how to append user data in 'dc_netlink_init' to be used in dc_genl_parseMsgFromUseSpace :-(
-struct minivosc_device *g_mydev_ptr = NULL;
+// netlink messages are routed by DC_GENL_ATTR_CARD (the enable[] index);
+// entries are published once a card is fully set up, readers use RCU
+static struct minivosc_device __rcu *g_mydevs[SNDRV_CARDS];
 
 #define SND_MINIVOSC_DRIVER    "snd_droidcam"
 
@@ -169,12 +446,28 @@ static int minivosc_remove(struct platform_device *devptr);
 static int minivosc_hw_params(struct snd_pcm_substream *ss,
                         struct snd_pcm_hw_params *hw_params);
 static int minivosc_hw_free(struct snd_pcm_substream *ss);
+static int minivosc_pcm_constraints(struct snd_pcm_runtime *runtime);
 static int minivosc_pcm_open(struct snd_pcm_substream *ss);
 static int minivosc_pcm_close(struct snd_pcm_substream *ss);
 static int minivosc_pcm_prepare(struct snd_pcm_substream *ss);
 static int minivosc_pcm_trigger(struct snd_pcm_substream *ss,
                           int cmd);
 static snd_pcm_uframes_t minivosc_pcm_pointer(struct snd_pcm_substream *ss);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,6,0)
+typedef struct timespec64 minivosc_timespec_t;
+#define minivosc_ns_to_timespec ns_to_timespec64
+#else
+typedef struct timespec minivosc_timespec_t;
+#define minivosc_ns_to_timespec ns_to_timespec
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0)
+static int minivosc_pcm_get_time_info(struct snd_pcm_substream *ss,
+                        minivosc_timespec_t *system_ts, minivosc_timespec_t *audio_ts,
+                        struct snd_pcm_audio_tstamp_config *audio_tstamp_config,
+                        struct snd_pcm_audio_tstamp_report *audio_tstamp_report);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3,8,0)
+static int minivosc_pcm_wall_clock(struct snd_pcm_substream *ss, struct timespec *audio_ts);
+#endif
 
 static int minivosc_pcm_dev_free(struct snd_device *device);
 static int minivosc_pcm_free(struct minivosc_device *chip);
@@ -183,7 +476,58 @@ static int minivosc_pcm_free(struct minivosc_device *chip);
 static void minivosc_timer_start(struct minivosc_device *mydev, unsigned timeout_ms);
 static void minivosc_timer_stop(struct minivosc_device *mydev);
 static void minivosc_timer_function(unsigned long data);
-static void minivosc_fill_capture_buf(struct minivosc_device *mydev, unsigned int bytes);
+static void minivosc_jiffies_start(struct minivosc_device *mydev);
+static void minivosc_jiffies_sync(struct minivosc_device *mydev);
+static void minivosc_hrtimer_start(struct minivosc_device *mydev);
+static void minivosc_hrtimer_stop(struct minivosc_device *mydev);
+static void minivosc_hrtimer_sync(struct minivosc_device *mydev);
+static enum hrtimer_restart minivosc_hrtimer_function(struct hrtimer *timer);
+static void minivosc_period_tasklet(unsigned long data);
+static void minivosc_jiffies_kick(struct minivosc_device *mydev);
+static void minivosc_hrtimer_kick(struct minivosc_device *mydev);
+static unsigned int minivosc_capture_bytes(struct minivosc_device *mydev, unsigned int bytes,
+                                           int pad, unsigned int *got);
+static unsigned int minivosc_stage_out(struct minivosc_device *mydev, unsigned int in_bytes, unsigned int bytes);
+static int minivosc_idle_enter(struct minivosc_device *mydev);
+static void minivosc_preroll(struct minivosc_device *mydev);
+static void minivosc_convert_out(struct minivosc_device *mydev, unsigned int bytes);
+static void minivosc_kick(struct minivosc_device *mydev);
+
+// * jitter buffer functions
+static int minivosc_jb_init(struct minivosc_jb *jb);
+static void minivosc_jb_free(struct minivosc_jb *jb);
+static int minivosc_jb_push(struct minivosc_jb *jb, unsigned sequence, s64 tstamp, const void *data, unsigned int len);
+static const struct minivosc_chunk *minivosc_jb_peek(struct minivosc_jb *jb);
+static void minivosc_jb_pop(struct minivosc_jb *jb);
+static void minivosc_jb_flush(struct minivosc_jb *jb);
+static void minivosc_proc_stats_read(struct snd_info_entry *entry, struct snd_info_buffer *buffer);
+static void minivosc_proc_stats_write(struct snd_info_entry *entry, struct snd_info_buffer *buffer);
+static void minivosc_stats_tick(struct minivosc_device *mydev, s64 late_ns);
+static void minivosc_feedback_tick(struct minivosc_device *mydev);
+static void minivosc_feedback_work(struct work_struct *work);
+static u32 minivosc_src_fill(struct minivosc_device *mydev, u32 *target);
+static s64 minivosc_pcm_ts(struct minivosc_device *mydev, s64 *first);
+static void minivosc_ptr_update(struct minivosc_device *mydev, unsigned int bytes);
+static void minivosc_ptr_sync(struct minivosc_device *mydev);
+static unsigned int minivosc_ptr_read(struct minivosc_device *mydev, u64 *lag_ns);
+
+// * virtual speaker (playback substream)
+static int minivosc_pb_init(struct minivosc_playback *pb);
+static void minivosc_pb_free(struct minivosc_playback *pb);
+static void minivosc_pb_work(struct work_struct *work);
+static int minivosc_pb_open(struct snd_pcm_substream *ss);
+static int minivosc_pb_close(struct snd_pcm_substream *ss);
+static int minivosc_pb_hw_params(struct snd_pcm_substream *ss, struct snd_pcm_hw_params *hw_params);
+static int minivosc_pb_hw_free(struct snd_pcm_substream *ss);
+static int minivosc_pb_prepare(struct snd_pcm_substream *ss);
+static int minivosc_pb_trigger(struct snd_pcm_substream *ss, int cmd);
+static snd_pcm_uframes_t minivosc_pb_pointer(struct snd_pcm_substream *ss);
+
+// * mmap ring functions
+static int minivosc_ring_init(struct minivosc_ring *ring, int dev);
+static void minivosc_ring_free(struct minivosc_ring *ring);
+static unsigned int minivosc_ring_peek(struct minivosc_ring *ring, const char **data);
+static void minivosc_ring_consume(struct minivosc_ring *ring, unsigned int bytes);
 
 
 // note snd_pcm_ops can usually be separate _playback_ops and _capture_ops
@@ -197,6 +541,39 @@ static struct snd_pcm_ops minivosc_pcm_ops =
 	.prepare   = minivosc_pcm_prepare,
 	.trigger   = minivosc_pcm_trigger,
 	.pointer   = minivosc_pcm_pointer,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0)
+	.get_time_info = minivosc_pcm_get_time_info,
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3,8,0)
+	.wall_clock = minivosc_pcm_wall_clock,
+#endif
+};
+
+static struct snd_pcm_ops minivosc_playback_ops =
+{
+	.open      = minivosc_pb_open,
+	.close     = minivosc_pb_close,
+	.ioctl     = snd_pcm_lib_ioctl,
+	.hw_params = minivosc_pb_hw_params,
+	.hw_free   = minivosc_pb_hw_free,
+	.prepare   = minivosc_pb_prepare,
+	.trigger   = minivosc_pb_trigger,
+	.pointer   = minivosc_pb_pointer,
+};
+
+static const struct minivosc_timer_ops minivosc_jiffies_ops =
+{
+	.start = minivosc_jiffies_start,
+	.stop  = minivosc_timer_stop,
+	.sync  = minivosc_jiffies_sync,
+	.kick  = minivosc_jiffies_kick,
+};
+
+static const struct minivosc_timer_ops minivosc_hrtimer_ops =
+{
+	.start = minivosc_hrtimer_start,
+	.stop  = minivosc_hrtimer_stop,
+	.sync  = minivosc_hrtimer_sync,
+	.kick  = minivosc_hrtimer_kick,
 };
 
 // specifies what func is called @ snd_card_free
@@ -227,6 +604,314 @@ static struct platform_driver minivosc_driver =
 };
 
 
+/*
+ *
+ * Jitter buffer functions
+ *
+ */
+static int minivosc_jb_init(struct minivosc_jb *jb)
+{
+	memset(jb, 0, sizeof(*jb));
+	jb->slots = vzalloc(MINIVOSC_JB_SLOTS * sizeof(struct minivosc_chunk));
+	if (!jb->slots)
+		return -ENOMEM;
+	jb->hist = vzalloc(MINIVOSC_HIST_SIZE);
+	if (!jb->hist) {
+		vfree(jb->slots);
+		return -ENOMEM;
+	}
+	jb->hist_on = 1;
+	jb->target = 1;
+	spin_lock_init(&jb->push_lock);
+	return 0;
+}
+
+static void minivosc_jb_free(struct minivosc_jb *jb)
+{
+	vfree(jb->slots);
+	vfree(jb->hist);
+	jb->slots = NULL;
+	jb->hist = NULL;
+}
+
+// producer side, under push_lock
+static void minivosc_jb_hist_write(struct minivosc_jb *jb, s64 tstamp, const char *data, unsigned int len)
+{
+	unsigned int ofs = jb->hist_head & (MINIVOSC_HIST_SIZE - 1);
+	unsigned int first = min(len, MINIVOSC_HIST_SIZE - ofs);
+
+	memcpy(jb->hist + ofs, data, first);
+	memcpy(jb->hist, data + first, len - first);
+	jb->hist_head += len;
+	jb->hist_ts = tstamp + (s64)len * (NSEC_PER_SEC / (DC_PCM_RATE * DC_PCM_SAMPLE_BYTES));
+	jb->hist_jiffies = jiffies;
+}
+
+// producer side, called from the netlink handler
+static int minivosc_jb_push(struct minivosc_jb *jb, unsigned sequence, s64 tstamp, const void *data, unsigned int len)
+{
+	unsigned int head;
+	struct minivosc_chunk *slot;
+	int diff;
+
+	spin_lock(&jb->push_lock);
+	head = jb->head;
+	diff = (int)(sequence - jb->last_sequence);
+
+	// a jump far backwards means the sender restarted; anything else
+	// that is not newer than what we have is a late duplicate
+	if (jb->last_sequence && diff <= 0 && diff > -MINIVOSC_JB_SLOTS) {
+		jb->drops++;
+		spin_unlock(&jb->push_lock);
+		return -EINVAL;
+	}
+
+	// while capture is stopped nothing drains the ring, but the history
+	// must stay fresh for pre-roll even once the ring is full
+	if (jb->hist_on)
+		minivosc_jb_hist_write(jb, tstamp, data, len);
+
+	if (head - ACCESS_ONCE(jb->tail) >= MINIVOSC_JB_SLOTS) {
+		// an idle mic is not overrun; pre-roll drops what is stale
+		if (!jb->hist_on)
+			jb->overruns++;
+		spin_unlock(&jb->push_lock);
+		return -ENOSPC;
+	}
+
+	slot = &jb->slots[head & MINIVOSC_JB_MASK];
+	slot->sequence = sequence;
+	slot->len = len;
+	slot->tstamp = tstamp;
+	memcpy(slot->data, data, len);
+	jb->last_sequence = sequence;
+	jb->last_len = len;
+	jb->chunks++;
+
+	// slot contents must be visible before the new head
+	smp_wmb();
+	ACCESS_ONCE(jb->head) = head + 1;
+	spin_unlock(&jb->push_lock);
+	return 0;
+}
+
+// consumer side, returns the oldest chunk or NULL while (re)buffering
+static const struct minivosc_chunk *minivosc_jb_peek(struct minivosc_jb *jb)
+{
+	unsigned int fill = ACCESS_ONCE(jb->head) - jb->tail;
+
+	if (!jb->primed) {
+		if (fill < jb->target)
+			return NULL;
+		jb->primed = 1;
+	}
+
+	if (fill == 0) {
+		jb->primed = 0;
+		return NULL;
+	}
+
+	smp_rmb();
+	return &jb->slots[jb->tail & MINIVOSC_JB_MASK];
+}
+
+static void minivosc_jb_pop(struct minivosc_jb *jb)
+{
+	jb->play_sequence = jb->slots[jb->tail & MINIVOSC_JB_MASK].sequence;
+	jb->read_ofs = 0;
+
+	// finish reading the slot before handing it back to the producer
+	smp_mb();
+	ACCESS_ONCE(jb->tail) = jb->tail + 1;
+}
+
+// consumer side, bytes not yet consumed
+static u32 minivosc_jb_bytes(struct minivosc_jb *jb)
+{
+	unsigned int i, head = ACCESS_ONCE(jb->head);
+	u32 bytes = 0;
+
+	smp_rmb();
+	for (i = jb->tail; i != head; i++)
+		bytes += jb->slots[i & MINIVOSC_JB_MASK].len;
+	return bytes - jb->read_ofs;
+}
+
+// consumer side, drop everything queued so far
+static void minivosc_jb_flush(struct minivosc_jb *jb)
+{
+	int depth = jb_depth;
+
+	if (depth < 1)
+		depth = 1;
+	if (depth > MINIVOSC_JB_SLOTS - 1)
+		depth = MINIVOSC_JB_SLOTS - 1;
+
+	jb->target = depth;
+	jb->primed = 0;
+	jb->play_sequence = 0;
+	jb->read_ofs = 0;
+	ACCESS_ONCE(jb->tail) = ACCESS_ONCE(jb->head);
+}
+
+/*
+ *
+ * mmap ring functions
+ *
+ */
+static int dc_ring_open(struct inode *inode, struct file *file)
+{
+	// misc_open() leaves our miscdevice in private_data
+	struct minivosc_ring *ring = container_of(file->private_data, struct minivosc_ring, misc);
+
+	// one producer at a time
+	if (test_and_set_bit(0, &ring->flags))
+		return -EBUSY;
+
+	memset(ring->ctl, 0, sizeof(*ring->ctl));
+	ring->ctl->magic = DC_RING_MAGIC;
+	ring->ctl->version = DC_RING_VERSION;
+	ring->ctl->size = DC_RING_DATA_SIZE;
+	ring->ctl->watermark = 2 * DC_PCM_CHUNK_DATA_LEN;
+	ring->tail = 0;
+	smp_wmb();
+	ACCESS_ONCE(ring->active) = 1;
+	// the ring can't signal new data, the clock polls while it is open
+	minivosc_kick(container_of(ring, struct minivosc_device, ring));
+
+	file->private_data = ring;
+	return 0;
+}
+
+static int dc_ring_release(struct inode *inode, struct file *file)
+{
+	struct minivosc_ring *ring = file->private_data;
+
+	// the area stays allocated, a timer still reading it sees stale data at worst
+	ACCESS_ONCE(ring->active) = 0;
+	clear_bit(0, &ring->flags);
+	return 0;
+}
+
+static int dc_ring_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct minivosc_ring *ring = file->private_data;
+
+	if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start > PAGE_ALIGN(DC_RING_MAP_SIZE))
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, ring->area, 0);
+}
+
+static u32 dc_ring_watermark(struct minivosc_ring *ring)
+{
+	u32 watermark = ACCESS_ONCE(ring->ctl->watermark);
+
+	// keep room for a full frame when the producer is woken
+	if (watermark > DC_RING_DATA_SIZE - DC_PCM_FRAME_MAX_LEN)
+		watermark = DC_RING_DATA_SIZE - DC_PCM_FRAME_MAX_LEN;
+	return watermark;
+}
+
+static unsigned int dc_ring_poll(struct file *file, poll_table *wait)
+{
+	struct minivosc_ring *ring = file->private_data;
+	u32 fill;
+
+	poll_wait(file, &ring->wait, wait);
+
+	fill = ACCESS_ONCE(ring->ctl->head) - ACCESS_ONCE(ring->tail);
+	if (fill < dc_ring_watermark(ring))
+		return POLLOUT | POLLWRNORM;
+	return 0;
+}
+
+static const struct file_operations dc_ring_fops =
+{
+	.owner   = THIS_MODULE,
+	.open    = dc_ring_open,
+	.release = dc_ring_release,
+	.mmap    = dc_ring_mmap,
+	.poll    = dc_ring_poll,
+	.llseek  = noop_llseek,
+};
+
+static int minivosc_ring_init(struct minivosc_ring *ring, int dev)
+{
+	int ret;
+
+	ring->area = vmalloc_user(PAGE_ALIGN(DC_RING_MAP_SIZE));
+	if (!ring->area)
+		return -ENOMEM;
+
+	ring->ctl = ring->area;
+	ring->data = (char *)ring->area + DC_RING_CTL_SIZE;
+	init_waitqueue_head(&ring->wait);
+
+	snprintf(ring->name, sizeof(ring->name), "droidcam_ring%d", dev);
+	ring->misc.minor = MISC_DYNAMIC_MINOR;
+	ring->misc.name = ring->name;
+	ring->misc.fops = &dc_ring_fops;
+
+	ret = misc_register(&ring->misc);
+	if (ret < 0) {
+		vfree(ring->area);
+		ring->area = NULL;
+	}
+	return ret;
+}
+
+static void minivosc_ring_free(struct minivosc_ring *ring)
+{
+	if (!ring->area)
+		return;
+
+	misc_deregister(&ring->misc);
+	vfree(ring->area);
+	ring->area = NULL;
+}
+
+// consumer side: bytes queued by the producer
+static u32 minivosc_ring_fill(struct minivosc_ring *ring)
+{
+	u32 fill = ACCESS_ONCE(ring->ctl->head) - ring->tail;
+
+	// the head lives in userspace memory, never trust it
+	if (fill > DC_RING_DATA_SIZE) {
+		dbg2("%s: bogus ring head, fill=%u", __func__, fill);
+		fill = 0;
+	}
+	return fill & ~(DC_PCM_SAMPLE_BYTES - 1);
+}
+
+// consumer side: contiguous readable bytes, data is read in place
+static unsigned int minivosc_ring_peek(struct minivosc_ring *ring, const char **data)
+{
+	u32 fill = minivosc_ring_fill(ring);
+	unsigned int ofs = ring->tail & (DC_RING_DATA_SIZE - 1);
+
+	// read the data only after seeing the head that covers it
+	smp_rmb();
+
+	*data = ring->data + ofs;
+	return min_t(unsigned int, fill, DC_RING_DATA_SIZE - ofs);
+}
+
+static void minivosc_ring_consume(struct minivosc_ring *ring, unsigned int bytes)
+{
+	u32 fill = minivosc_ring_fill(ring);
+	u32 watermark = dc_ring_watermark(ring);
+
+	// done reading before the producer may reuse the space
+	smp_mb();
+	ring->tail += bytes;
+	ACCESS_ONCE(ring->ctl->tail) = ring->tail;
+
+	// only wake the producer when crossing the watermark
+	if (fill >= watermark && fill - bytes < watermark)
+		wake_up_interruptible(&ring->wait);
+}
+
 /*
  * Netlink related code for DroidCam
  * References:
@@ -237,6 +922,11 @@ static struct platform_driver minivosc_driver =
 // attribute policies
 static struct nla_policy dc_genl_policy[DC_GENL_ATTR_MAX] = {
 	[DC_GENL_ATTR_S16LE_16K_100MS_PCM] = { .type = NLA_BINARY, .len = DC_PCM_CHUNK_BYTES },
+	[DC_GENL_ATTR_PCM_SEQUENCE] = { .type = NLA_U32 },
+	[DC_GENL_ATTR_PCM_SAMPLES]  = { .type = NLA_U32 },
+	[DC_GENL_ATTR_PCM_DATA]     = { .type = NLA_BINARY, .len = DC_PCM_FRAME_MAX_LEN },
+	[DC_GENL_ATTR_CARD]         = { .type = NLA_U32 },
+	[DC_GENL_ATTR_PCM_TIMESTAMP] = { .type = NLA_U64 },
 };
 
 // family definition
@@ -246,9 +936,24 @@ static struct genl_family dc_genl_family = {
 	.name    = DC_GENL_FAMILY_NAME,
 	.version = DC_GENL_VERSION,
 	.maxattr = ( DC_GENL_ATTR_MAX - 1 ),
+	// don't take genl_mutex (shared with every genetlink user on the host)
+	// around our handlers; each card has its own producer lock instead
+	.parallel_ops = true,
 };
 
 static int dc_genl_s16le_16k_100ms_pcm_handler(struct sk_buff *skb, struct genl_info *info);
+static int dc_genl_pcm_handler(struct sk_buff *skb, struct genl_info *info);
+
+// indices are the group argument of genlmsg_multicast()
+enum {
+	DC_GENL_GRP_FEEDBACK,		/* minivosc_feedback_work */
+	DC_GENL_GRP_PLAYBACK,		/* minivosc_pb_work */
+};
+
+static const struct genl_multicast_group dc_genl_mcgrps[] = {
+	[DC_GENL_GRP_FEEDBACK] = { .name = DC_GENL_MCGRP_FEEDBACK },
+	[DC_GENL_GRP_PLAYBACK] = { .name = DC_GENL_MCGRP_PLAYBACK },
+};
 
 struct genl_ops dc_genl_ops[] = {
  {
@@ -258,6 +963,13 @@ struct genl_ops dc_genl_ops[] = {
 	.doit = dc_genl_s16le_16k_100ms_pcm_handler,
 	.dumpit = NULL,
  },
+ {
+	.cmd = DC_GENL_CMD_PCM,
+	.flags = 0,
+	.policy = dc_genl_policy,
+	.doit = dc_genl_pcm_handler,
+	.dumpit = NULL,
+ },
 };
 
 static int is_genl_family_registered = 0;
@@ -265,6 +977,9 @@ static int is_genl_family_registered = 0;
 static int dc_netlink_init(void)
 {
 	int rc;
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,13,0)
+	int i;
+#endif
 	is_genl_family_registered = 0;
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,13,0)
@@ -276,10 +991,11 @@ static int dc_netlink_init(void)
 		goto EARLY_OUT;
 	}
 
-	rc = genl_register_ops(&dc_genl_family, &dc_genl_ops[0]);
+	for (i = 0; i < ARRAY_SIZE(dc_genl_ops) && rc == 0; i++)
+		rc = genl_register_ops(&dc_genl_family, &dc_genl_ops[i]);
 #else
 
-	rc = genl_register_family_with_ops(&dc_genl_family, dc_genl_ops);
+	rc = genl_register_family_with_ops_groups(&dc_genl_family, dc_genl_ops, dc_genl_mcgrps);
 #endif
 	if (rc != 0) {
 		dbg("%s: error: genl_register_ops() returned %d", __func__, rc);
@@ -295,14 +1011,19 @@ EARLY_OUT:
 static void dc_netlink_fini(void)
 {
 	int rc;
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,13,0)
+	int i;
+#endif
 	if (is_genl_family_registered == 0) return;
 	is_genl_family_registered = 0;
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,13,0)
 #error Kernels below v3.13 not tested yet
-	rc = genl_unregister_ops(&dc_genl_family, &dc_genl_ops[0]);
-	if (rc != 0) {
-		dbg("%s: error: genl_UNregister_ops() returned %d", __func__, rc);
+	for (i = 0; i < ARRAY_SIZE(dc_genl_ops); i++) {
+		rc = genl_unregister_ops(&dc_genl_family, &dc_genl_ops[i]);
+		if (rc != 0) {
+			dbg("%s: error: genl_UNregister_ops() returned %d", __func__, rc);
+		}
 	}
 #endif
 
@@ -312,9 +1033,36 @@ static void dc_netlink_fini(void)
 	}
 }
 
+// caller holds rcu_read_lock()
+static struct minivosc_device *dc_genl_lookup(struct genl_info *pInfo)
+{
+	unsigned card = 0;
+
+	// senders that predate multiple cards feed card 0
+	if (pInfo->attrs[DC_GENL_ATTR_CARD])
+		card = nla_get_u32(pInfo->attrs[DC_GENL_ATTR_CARD]);
+
+	if (card >= SNDRV_CARDS)
+		return NULL;
+	return rcu_dereference(g_mydevs[card]);
+}
+
+// any sender may send malformed frames as fast as it likes: count them,
+// but only log some
+static void dc_genl_reject(struct minivosc_device *mydev)
+{
+	spin_lock(&mydev->jb.push_lock);
+	mydev->jb.rejects++;
+	spin_unlock(&mydev->jb.push_lock);
+}
+
 static int dc_genl_parseMsgFromUserSpace(struct genl_info *pInfo)
 {
 	struct nlattr *pAttr1 = NULL;
+	struct nlattr *pAttrData = NULL;
+	struct minivosc_device *mydev;
+	s64 tstamp;
+	int rc = 0;
 	// dbg("%s()", __func__);
 
 	// pAttrX = pInfo->attrs[?];
@@ -322,24 +1070,74 @@ static int dc_genl_parseMsgFromUserSpace(struct genl_info *pInfo)
 	// ..
 	// }
 
+	// handlers run in parallel (parallel_ops), the card lookup is RCU
+	// and minivosc_jb_push() serializes producers of the same card
+	rcu_read_lock();
+	mydev = dc_genl_lookup(pInfo);
+	if (!mydev) {
+		rc = -ENODEV;
+		goto EARLY_OUT;
+	}
+
+	// without a capture time from the sender, transport latency is not accounted for
+	if (pInfo->attrs[DC_GENL_ATTR_PCM_TIMESTAMP])
+		tstamp = (s64)nla_get_u64(pInfo->attrs[DC_GENL_ATTR_PCM_TIMESTAMP]);
+	else
+		tstamp = ktime_to_ns(ktime_get());
+
 	pAttr1 = pInfo->attrs[DC_GENL_ATTR_S16LE_16K_100MS_PCM];
 	if (pAttr1) {
 		int len = nla_len(pAttr1);
 		struct dc_pcm_chunk_s *chunk = (struct dc_pcm_chunk_s *) nla_data(pAttr1);
-		// dbg("PCM chunk nla_data=%p len=%d (g_mydev_ptr=%p)", chunk, len, g_mydev_ptr);
+		// dbg("PCM chunk nla_data=%p len=%d (mydev=%p)", chunk, len, mydev);
 		if (!chunk || len < DC_PCM_CHUNK_BYTES) {
-			err("[droidam_snd] got null pcm chunk! data=%p len=%d", chunk->data, len);
+			dc_genl_reject(mydev);
+			if (net_ratelimit())
+				err("[droidam_snd] got null pcm chunk! data=%p len=%d", chunk, len);
+			rc = -EINVAL;
+			goto EARLY_OUT;
+		}
+		rc = minivosc_jb_push(&mydev->jb, chunk->sequence, tstamp, chunk->data, DC_PCM_CHUNK_DATA_LEN);
+		trace_minivosc_chunk_rx(mydev->dev_id, chunk->sequence, DC_PCM_CHUNK_DATA_LEN, rc);
+		if (rc == 0)
+			minivosc_kick(mydev);
+		// a late or surplus chunk is not the sender's error
+		rc = 0;
+	}
+
+	pAttrData = pInfo->attrs[DC_GENL_ATTR_PCM_DATA];
+	if (pAttrData) {
+		int len = nla_len(pAttrData);
+		unsigned sequence, samples;
+
+		if (!pInfo->attrs[DC_GENL_ATTR_PCM_SEQUENCE] || !pInfo->attrs[DC_GENL_ATTR_PCM_SAMPLES]) {
+			dc_genl_reject(mydev);
+			if (net_ratelimit())
+				err("[droidam_snd] pcm frame without sequence/samples");
+			rc = -EINVAL;
 			goto EARLY_OUT;
 		}
-		// todo
-		// lock the buffer, make the read/writes atomic somehow
-		if (g_mydev_ptr) {
-			g_mydev_ptr->back_buffer = *chunk;
+		sequence = nla_get_u32(pInfo->attrs[DC_GENL_ATTR_PCM_SEQUENCE]);
+		samples = nla_get_u32(pInfo->attrs[DC_GENL_ATTR_PCM_SAMPLES]);
+
+		// the policy only bounds the length, make sure it matches
+		if (samples == 0 || len != samples * DC_PCM_SAMPLE_BYTES) {
+			dc_genl_reject(mydev);
+			if (net_ratelimit())
+				err("[droidam_snd] bad pcm frame: seq=%u samples=%u len=%d", sequence, samples, len);
+			rc = -EINVAL;
+			goto EARLY_OUT;
 		}
+		rc = minivosc_jb_push(&mydev->jb, sequence, tstamp, nla_data(pAttrData), len);
+		trace_minivosc_chunk_rx(mydev->dev_id, sequence, len, rc);
+		if (rc == 0)
+			minivosc_kick(mydev);
+		rc = 0;
 	}
 
 EARLY_OUT:
-	return 0;
+	rcu_read_unlock();
+	return rc;
 }
 
 #if 0
@@ -410,6 +1208,16 @@ static int dc_genl_s16le_16k_100ms_pcm_handler(struct sk_buff *skb, struct genl_
 	return 0;
 }
 
+static int dc_genl_pcm_handler(struct sk_buff *skb, struct genl_info *info)
+{
+	if (skb == NULL || info == NULL){
+		dbg("%s: error: NULL at input. skb=%p, info=%p", __func__, skb, info);
+		return -EINVAL;
+	}
+
+	return dc_genl_parseMsgFromUserSpace(info);
+}
+
 // -- end netlink code
 //
 /*
@@ -430,6 +1238,7 @@ static int minivosc_probe(struct platform_device *devptr)
 
 	int nr_subdevs; // how many capture substreams we want
 	struct snd_pcm *pcm;
+	struct snd_info_entry *entry;
 
 	int dev = devptr->id; // from aloop-kernel.c
 
@@ -445,15 +1254,17 @@ static int minivosc_probe(struct platform_device *devptr)
 
 	mydev = card->private_data;
 	mydev->card = card;
+	mydev->dev_id = dev;
 	// MUST have mutex_init here - else crash on mutex_lock!!
 	mutex_init(&mydev->cable_lock);
+	seqcount_init(&mydev->ts_seq);
+	INIT_WORK(&mydev->fb_work, minivosc_feedback_work);
 
 	dbg2("-- mydev %p", mydev);
-	g_mydev_ptr = mydev;
 
 	sprintf(card->driver, SND_MINIVOSC_DRIVER);
 	sprintf(card->shortname, "DroidCam-Mic");
-	sprintf(card->longname, "DroidCam Virtual Mic");
+	sprintf(card->longname, "DroidCam Virtual Mic %d", dev);
 
 	snd_card_set_dev(card, &devptr->dev); // present in dummy, not in aloop though
 
@@ -462,16 +1273,39 @@ static int minivosc_probe(struct platform_device *devptr)
 	if (ret < 0)
 		goto __nodev;
 
+	// after snd_device_new, so snd_card_free releases it on error
+	ret = minivosc_jb_init(&mydev->jb);
+
+	if (ret < 0)
+		goto __nodev;
+
+	ret = minivosc_ring_init(&mydev->ring, dev);
+
+	if (ret < 0)
+		goto __nodev;
+
+	ret = minivosc_pb_init(&mydev->pb);
+
+	if (ret < 0)
+		goto __nodev;
+
+	if (!snd_card_proc_new(card, "stats", &entry)) {
+		snd_info_set_text_ops(entry, mydev, minivosc_proc_stats_read);
+		entry->c.text.write = minivosc_proc_stats_write;
+		entry->mode |= S_IWUSR;
+	}
+
 
 	nr_subdevs = 1; // how many capture substreams we want
-	// * we want 0 playback, and 1 capture substreams (4th and 5th arg) ..
-	ret = snd_pcm_new(card, card->driver, 0, 0, nr_subdevs, &pcm);
+	// * we want 1 playback (the virtual speaker), and 1 capture substreams (4th and 5th arg) ..
+	ret = snd_pcm_new(card, card->driver, 0, 1, nr_subdevs, &pcm);
 
 	if (ret < 0)
 		goto __nodev;
 
 
 	snd_pcm_set_ops(pcm, SNDRV_PCM_STREAM_CAPTURE, &minivosc_pcm_ops); // in both aloop-kernel.c and dummy.c, after snd_pcm_new...
+	snd_pcm_set_ops(pcm, SNDRV_PCM_STREAM_PLAYBACK, &minivosc_playback_ops);
 	pcm->private_data = mydev; //here it should be dev/card struct (the one containing struct snd_card *card) - this DOES NOT end up in substream->private_data
 
 	pcm->info_flags = 0;
@@ -496,6 +1330,8 @@ static int minivosc_probe(struct platform_device *devptr)
 	if (ret == 0)   // or... (!ret)
 	{
 		platform_set_drvdata(devptr, card);
+		// only a complete card gets netlink frames routed to it
+		rcu_assign_pointer(g_mydevs[dev], mydev);
 		return 0; // success
 	}
 
@@ -526,41 +1362,159 @@ static int minivosc_remove(struct platform_device *devptr)
  */
 static int minivosc_hw_params(struct snd_pcm_substream *ss, struct snd_pcm_hw_params *hw_params)
 {
+	struct minivosc_device *mydev = ss->runtime->private_data;
+	unsigned int rate = params_rate(hw_params), len;
+	int quality = clamp(rs_quality, 0, MINIVOSC_PP_QUALITY_MAX);
+	int ret;
+
 	dbg("%s", __func__);
-	return snd_pcm_lib_malloc_pages(ss, params_buffer_bytes(hw_params));
+	ret = snd_pcm_lib_malloc_pages(ss, params_buffer_bytes(hw_params));
+	if (ret < 0)
+		return ret;
+
+	// anything but S16_LE mono is filled in S16 mono first, then converted
+	vfree(mydev->shadow);
+	mydev->shadow = NULL;
+	if (params_format(hw_params) != SNDRV_PCM_FORMAT_S16_LE || params_channels(hw_params) != 1) {
+		mydev->shadow = vmalloc(params_buffer_size(hw_params) * DC_PCM_SAMPLE_BYTES);
+		if (!mydev->shadow)
+			goto EARLY_OUT;
+	}
+
+	// likewise anything above 16kHz is resampled; the phase filters
+	// depend on the ratio, so they are built here once per stream
+	vfree(mydev->pp_coef);
+	mydev->pp_coef = NULL;
+	if (rate != DC_PCM_RATE) {
+		len = minivosc_pp_coef_len(DC_PCM_RATE, rate, quality);
+		if (!len) {
+			ret = -EINVAL;
+			goto EARLY_OUT;
+		}
+		mydev->pp_coef = vmalloc(len * sizeof(s16));
+		if (!mydev->pp_coef)
+			goto EARLY_OUT;
+		minivosc_pp_init(&mydev->pp, DC_PCM_RATE, rate, quality, mydev->pp_coef);
+		dbg2("	resampling %u -> %u Hz, %u phases of %u taps", DC_PCM_RATE, rate, mydev->pp.L, mydev->pp.taps);
+	}
+	return ret;
+
+EARLY_OUT:
+	vfree(mydev->shadow);
+	mydev->shadow = NULL;
+	snd_pcm_lib_free_pages(ss);
+	return ret < 0 ? ret : -ENOMEM;
 }
 
 static int minivosc_hw_free(struct snd_pcm_substream *ss)
 {
+	struct minivosc_device *mydev = ss->runtime->private_data;
+
 	dbg("%s", __func__);
+	vfree(mydev->shadow);
+	mydev->shadow = NULL;
+	vfree(mydev->pp_coef);
+	mydev->pp_coef = NULL;
 	return snd_pcm_lib_free_pages(ss);
 }
 
-
 /*
- *
- * PCM functions
- *
+ * Period size in frames follows the rate: period_ms_min..period_ms_max
+ * of audio whatever rate was picked.
  */
-static int minivosc_pcm_open(struct snd_pcm_substream *ss)
+static int minivosc_hw_rule_period(struct snd_pcm_hw_params *params, struct snd_pcm_hw_rule *rule)
 {
-	struct minivosc_device *mydev = ss->private_data;
+	struct snd_interval *rate = hw_param_interval(params, SNDRV_PCM_HW_PARAM_RATE);
+	struct snd_interval t;
+
+	snd_interval_any(&t);
+	t.min = DIV_ROUND_UP(rate->min * period_ms_min, 1000);
+	t.max = rate->max * period_ms_max / 1000;
+	t.integer = 1;
+	return snd_interval_refine(hw_param_interval(params, SNDRV_PCM_HW_PARAM_PERIOD_SIZE), &t);
+}
 
-	//BREAKPOINT();
-	dbg("%s", __func__);
+static int minivosc_hw_rule_buffer(struct snd_pcm_hw_params *params, struct snd_pcm_hw_rule *rule)
+{
+	struct snd_interval *rate = hw_param_interval(params, SNDRV_PCM_HW_PARAM_RATE);
+	struct snd_interval t;
 
-	// copied from aloop-kernel.c:
-	mutex_lock(&mydev->cable_lock);
+	snd_interval_any(&t);
+	t.max = rate->max * buffer_ms_max / 1000;
+	t.integer = 1;
+	return snd_interval_refine(hw_param_interval(params, SNDRV_PCM_HW_PARAM_BUFFER_SIZE), &t);
+}
 
-	ss->runtime->hw = minivosc_pcm_hw;
+static int minivosc_pcm_constraints(struct snd_pcm_runtime *runtime)
+{
+	int ret;
 
-	mydev->substream = ss; 	//save (system given) substream *ss, in our structure field
+	// the clocks deliver whole periods, the buffer must hold a whole number
+	ret = snd_pcm_hw_constraint_integer(runtime, SNDRV_PCM_HW_PARAM_PERIODS);
+	if (ret < 0)
+		return ret;
+
+	ret = snd_pcm_hw_rule_add(runtime, 0, SNDRV_PCM_HW_PARAM_PERIOD_SIZE,
+	                          minivosc_hw_rule_period, NULL, SNDRV_PCM_HW_PARAM_RATE, -1);
+	if (ret < 0)
+		return ret;
+
+	ret = snd_pcm_hw_rule_add(runtime, 0, SNDRV_PCM_HW_PARAM_BUFFER_SIZE,
+	                          minivosc_hw_rule_buffer, NULL, SNDRV_PCM_HW_PARAM_RATE, -1);
+	if (ret < 0)
+		return ret;
+
+	if (period_pow2) {
+		ret = snd_pcm_hw_constraint_pow2(runtime, 0, SNDRV_PCM_HW_PARAM_PERIOD_SIZE);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+
+/*
+ *
+ * PCM functions
+ *
+ */
+static int minivosc_pcm_open(struct snd_pcm_substream *ss)
+{
+	struct minivosc_device *mydev = ss->private_data;
+	int ret;
+
+	//BREAKPOINT();
+	dbg("%s", __func__);
+
+	// copied from aloop-kernel.c:
+	mutex_lock(&mydev->cable_lock);
+
+	ss->runtime->hw = minivosc_pcm_hw;
+	ss->runtime->hw.buffer_bytes_max = MAX_BUFFER;
+	ss->runtime->hw.period_bytes_max = MAX_BUFFER / 2;
+	ret = minivosc_pcm_constraints(ss->runtime);
+	if (ret < 0) {
+		mutex_unlock(&mydev->cable_lock);
+		return ret;
+	}
+	// without interpolation the pointer moves in whole fills
+	mydev->ptr_interp = pointer_interp;
+	if (!mydev->ptr_interp)
+		ss->runtime->hw.info |= SNDRV_PCM_INFO_BATCH;
+
+	mydev->substream = ss; 	//save (system given) substream *ss, in our structure field
 	ss->runtime->private_data = mydev;
 
 	// todo init
 
 	// SETUP THE TIMER HERE:
 	setup_timer(&mydev->timer, minivosc_timer_function, /* user data */(unsigned long)mydev);
+	hrtimer_init(&mydev->hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	mydev->hrtimer.function = minivosc_hrtimer_function;
+	tasklet_init(&mydev->period_tasklet, minivosc_period_tasklet, (unsigned long)mydev);
+	mydev->timer_ops = timer_mode ? &minivosc_hrtimer_ops : &minivosc_jiffies_ops;
+	dbg2("	capture clock: %s", timer_mode ? "hrtimer" : "jiffies");
 
 	mutex_unlock(&mydev->cable_lock);
 	return 0;
@@ -576,7 +1530,9 @@ static int minivosc_pcm_close(struct snd_pcm_substream *ss)
 	// * even though mutexes are retrieved from ss->private_data,
 	// * which will be set to null,
 	// * lock the mutex here anyway:
+	mydev->timer_ops->sync(mydev);
 	mutex_lock(&mydev->cable_lock);
+	dbg("	jitter buffer: chunks=%lu drops=%lu overruns=%lu rejects=%lu underruns=%lu gaps=%lu last-seq=%u", mydev->jb.chunks, mydev->jb.drops, mydev->jb.overruns, mydev->jb.rejects, mydev->stats.underruns, mydev->stats.gaps, mydev->jb.last_sequence);
 	// * not much else to do here, but set to null:
 	ss->private_data = NULL;
 	mutex_unlock(&mydev->cable_lock);
@@ -596,24 +1552,46 @@ static int minivosc_pcm_prepare(struct snd_pcm_substream *ss)
 	// .. UNLESS runtime->private_data is assigned in _open?
 	struct snd_pcm_runtime *runtime = ss->runtime;
 	struct minivosc_device *mydev = runtime->private_data;
-	unsigned int bps; // bytes per sec (eg. 16000 @ PCM16 8000Hz)
-	unsigned int format_width = snd_pcm_format_width(runtime->format) / 8;
+	unsigned int bps; // bytes per sec of the S16 mono we fill (32000 @ 16kHz)
+	static const u8 silence[8]; /* S16 */
 
 	dbg("%s()", __func__);
-	dbg2("	runtime->rate=%d (format_width=%d), runtime->channels=%d", runtime->rate, format_width, runtime->channels);
+	mydev->timer_ops->sync(mydev);
+	dbg2("	runtime->rate=%d (format=%d), runtime->channels=%d", runtime->rate, runtime->format, runtime->channels);
+
+	switch (runtime->format) {
+	case SNDRV_PCM_FORMAT_S16_LE: mydev->conv_fmt = MINIVOSC_FMT_S16; break;
+	case SNDRV_PCM_FORMAT_U16_LE: mydev->conv_fmt = MINIVOSC_FMT_U16; break;
+	case SNDRV_PCM_FORMAT_S32_LE: mydev->conv_fmt = MINIVOSC_FMT_S32; break;
+	default:
+		return -EINVAL;
+	}
+	mydev->conv_channels = runtime->channels;
 
-	bps = runtime->rate * runtime->channels * format_width; // params requested by user app (arecord, audacity)
+	// everything from here on counts bytes of S16 mono at the app's rate,
+	// whatever format it opened; only minivosc_convert_out and the pointer
+	// deal in its frames. The source side (stage) is always 16kHz.
+	bps = runtime->rate * DC_PCM_SAMPLE_BYTES;
 	if (bps <= 0)
 		return -EINVAL;
 
-	mydev->buf_pos = 0;
-	mydev->pcm_buffer_size = frames_to_bytes(runtime, runtime->buffer_size);
+	mydev->pcm_buffer_size = runtime->buffer_size * DC_PCM_SAMPLE_BYTES;
 	dbg2("	bps: %u; runtime->buffer_size: %lu; mydev->pcm_buffer_size: %u", bps, runtime->buffer_size, mydev->pcm_buffer_size);
+
+	minivosc_dma_init(&mydev->dma, mydev->shadow ? (void *)mydev->shadow : runtime->dma_area,
+	                  mydev->pcm_buffer_size, silence);
 	if (ss->stream == SNDRV_PCM_STREAM_CAPTURE) {
-		mydev->silent_size = mydev->pcm_buffer_size;
-		memset(runtime->dma_area, 0, mydev->pcm_buffer_size);
+		minivosc_dma_silence(&mydev->dma, mydev->pcm_buffer_size);
+		if (mydev->shadow)
+			snd_pcm_format_set_silence(runtime->format, runtime->dma_area,
+			                           runtime->buffer_size * runtime->channels);
 	}
 
+	minivosc_dma_init(&mydev->stage, mydev->stage_buf, sizeof(mydev->stage_buf), silence);
+	mydev->sink = mydev->pp_coef ? &mydev->stage : &mydev->dma;
+	if (mydev->pp_coef)
+		minivosc_pp_reset(&mydev->pp);
+
 	if (!mydev->running) {
 		mydev->irq_pos = 0;
 	}
@@ -621,15 +1599,29 @@ static int minivosc_pcm_prepare(struct snd_pcm_substream *ss)
 	mutex_lock(&mydev->cable_lock);
 	if (!(mydev->valid & ~(1 << ss->stream))) {
 		mydev->pcm_bps = bps;
-		mydev->pcm_period_size = frames_to_bytes(runtime, runtime->period_size);
+		mydev->pcm_period_size = runtime->period_size * DC_PCM_SAMPLE_BYTES;
 		mydev->period_size_frac = frac_pos(mydev->pcm_period_size);
 	}
 	mydev->valid |= 1 << ss->stream;
 	mutex_unlock(&mydev->cable_lock);
 
 	dbg2("	pcm_period_size=%u; period_size_frac=%u", mydev->pcm_period_size, mydev->period_size_frac);
-	mydev->last_sequence = 0;
-	mydev->back_buffer.sequence = 0;
+	minivosc_jb_flush(&mydev->jb);
+
+	mydev->drift_comp = drift_comp;
+	minivosc_drift_reset(&mydev->drift);
+	minivosc_rs_reset(&mydev->rs);
+
+	mydev->plc_frames = plc_frames > 0 ? plc_frames : 0;
+	mydev->plc_bytes = 0;
+	mydev->padded = 0;
+	minivosc_plc_reset(&mydev->plc);
+
+	mydev->next_ts = 0;
+	mydev->first_ts = 0;
+	mydev->written = 0;
+	mydev->ptr_base = 0;
+	mydev->ptr_time = ktime_get();
 
 	return 0;
 }
@@ -653,7 +1645,8 @@ static int minivosc_pcm_trigger(struct snd_pcm_substream *ss,
 			// Start the hardware capture
 			// from aloop-kernel.c:
 			if (!mydev->running) {
-				minivosc_timer_start(mydev, 100);
+				minivosc_preroll(mydev);
+				mydev->timer_ops->start(mydev);
 			}
 			mydev->running |= (1 << ss->stream);
 			break;
@@ -661,9 +1654,11 @@ static int minivosc_pcm_trigger(struct snd_pcm_substream *ss,
 			// Stop the hardware capture
 			// from aloop-kernel.c:
 			mydev->running &= ~(1 << ss->stream);
-			if (!mydev->running)
+			if (!mydev->running) {
 				// STOP THE TIMER HERE:
-				minivosc_timer_stop(mydev);
+				mydev->timer_ops->stop(mydev);
+				ACCESS_ONCE(mydev->jb.hist_on) = 1;
+			}
 			break;
 		default:
 			ret = -EINVAL;
@@ -678,13 +1673,75 @@ static snd_pcm_uframes_t minivosc_pcm_pointer(struct snd_pcm_substream *ss)
 	//copied from aloop-kernel.c
 	struct snd_pcm_runtime *runtime = ss->runtime;
 	struct minivosc_device *mydev= runtime->private_data;
+	unsigned int pos;
+	u64 lag;
+	s64 age, ts = minivosc_pcm_ts(mydev, NULL);
 
 	// dbg2("+minivosc_pointer ");
 	// minivosc_pos_update(mydev);
-	// dbg2("+	bytes_to_frames(: %lu, mydev->buf_pos: %d", bytes_to_frames(runtime, mydev->buf_pos),mydev->buf_pos);
-	return bytes_to_frames(runtime, mydev->buf_pos);
+	// dbg2("+	bytes_to_frames(: %lu, mydev->dma.pos: %d", bytes_to_frames(runtime, mydev->dma.pos),mydev->dma.pos);
+	pos = minivosc_ptr_read(mydev, &lag);
+
+	// frames captured by the sender but not at the hw pointer yet:
+	// transport plus jitter buffer latency, plus what the interpolated
+	// pointer holds back
+	age = ts ? ktime_to_ns(ktime_get()) - ts + lag : 0;
+	runtime->delay = age > 0 ? div_u64((u64)age * runtime->rate, NSEC_PER_SEC) : 0;
+
+	return pos / DC_PCM_SAMPLE_BYTES;
+
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0)
+static int minivosc_pcm_get_time_info(struct snd_pcm_substream *ss,
+                        minivosc_timespec_t *system_ts, minivosc_timespec_t *audio_ts,
+                        struct snd_pcm_audio_tstamp_config *audio_tstamp_config,
+                        struct snd_pcm_audio_tstamp_report *audio_tstamp_report)
+{
+	struct minivosc_device *mydev = ss->runtime->private_data;
+	s64 first, ts = minivosc_pcm_ts(mydev, &first);
+	u64 lag;
+
+	snd_pcm_gettime(ss->runtime, system_ts);
+	// the hw pointer may trail the audio ts belongs to
+	minivosc_ptr_read(mydev, &lag);
+	if (ts)
+		ts -= lag;
+
+	switch (audio_tstamp_config->type_requested) {
+	case SNDRV_PCM_AUDIO_TSTAMP_TYPE_LINK_ABSOLUTE:
+		*audio_ts = minivosc_ns_to_timespec(ts);
+		break;
+	case SNDRV_PCM_AUDIO_TSTAMP_TYPE_LINK:
+		*audio_ts = minivosc_ns_to_timespec(ts - first);
+		break;
+	default:
+		// let the core derive it from the hw pointer
+		audio_tstamp_report->actual_type = SNDRV_PCM_AUDIO_TSTAMP_TYPE_DEFAULT;
+		return 0;
+	}
+
+	if (!ts) {
+		audio_tstamp_report->actual_type = SNDRV_PCM_AUDIO_TSTAMP_TYPE_DEFAULT;
+		return 0;
+	}
 
+	audio_tstamp_report->actual_type = audio_tstamp_config->type_requested;
+	audio_tstamp_report->valid = 1;
+	return 0;
 }
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3,8,0)
+static int minivosc_pcm_wall_clock(struct snd_pcm_substream *ss, struct timespec *audio_ts)
+{
+	struct minivosc_device *mydev = ss->runtime->private_data;
+	s64 first, ts = minivosc_pcm_ts(mydev, &first);
+	u64 lag;
+
+	minivosc_ptr_read(mydev, &lag);
+	*audio_ts = ns_to_timespec(ts ? ts - lag - first : 0);
+	return 0;
+}
+#endif
 
 
 /*
@@ -707,10 +1764,38 @@ static void minivosc_timer_stop(struct minivosc_device *mydev)
 	del_timer(&mydev->timer);
 }
 
+static void minivosc_jiffies_start(struct minivosc_device *mydev)
+{
+	clear_bit(0, &mydev->idle);
+	minivosc_timer_start(mydev, max(mydev->pcm_period_size * 1000 / mydev->pcm_bps, 1U));
+}
+
+static void minivosc_jiffies_sync(struct minivosc_device *mydev)
+{
+	clear_bit(0, &mydev->idle);
+	del_timer_sync(&mydev->timer);
+	// pre-roll reports its period through the tasklet in this mode too
+	tasklet_kill(&mydev->period_tasklet);
+}
+
+// data landed while idle: run now, with a period's worth of budget so it
+// goes out right away
+static void minivosc_jiffies_kick(struct minivosc_device *mydev)
+{
+	unsigned long period = msecs_to_jiffies(mydev->pcm_period_size * 1000 / mydev->pcm_bps);
+
+	if (!ACCESS_ONCE(mydev->running))
+		return;
+	mydev->last_jiffies = jiffies - max(period, 1UL);
+	mod_timer(&mydev->timer, jiffies);
+}
+
 static void minivosc_timer_function(unsigned long data)
 {
 	int timeout_ms = 10;
-	unsigned int last_pos, count;
+	unsigned int last_pos, count, n, got;
+	s64 late_ns;
+	ktime_t now;
 	unsigned long delta;
 	unsigned long jiffies_now = jiffies;
 	struct minivosc_device *mydev = (struct minivosc_device *)data;
@@ -720,6 +1805,12 @@ static void minivosc_timer_function(unsigned long data)
 	if (!mydev->running)
 		return;
 
+	// timer.expires still holds the expiry we were armed for
+	late_ns = (s64)jiffies_to_usecs(jiffies_now - mydev->timer.expires) * NSEC_PER_USEC;
+	now = ktime_get();
+	trace_minivosc_timer_fire(mydev->dev_id, ktime_sub_ns(now, late_ns), now);
+	minivosc_stats_tick(mydev, late_ns);
+
 	if (delta == 0)
 		goto timer_restart;
 
@@ -728,25 +1819,36 @@ static void minivosc_timer_function(unsigned long data)
 	last_pos = byte_pos(mydev->irq_pos);
 	mydev->irq_pos += delta * mydev->pcm_bps;
 	count = byte_pos(mydev->irq_pos) - last_pos;
-	dbg2("*	: bytes count=%d (dma buf pos=%d, size=%d)", count, mydev->buf_pos, mydev->pcm_buffer_size);
+	dbg2("*	: bytes count=%d (dma buf pos=%d, size=%d)", count, mydev->dma.pos, mydev->pcm_buffer_size);
 	if (count == 0)
 		goto timer_restart;
 
-	dbg2("*	: dc_back_buffer curr-seq=%d last-seq=%d", mydev->back_buffer.sequence, mydev->last_sequence);
-	if (mydev->back_buffer.sequence <= mydev->last_sequence) {
+	// FILL BUFFER HERE
+	dbg2("*	: jitter buffer head=%u tail=%u", mydev->jb.head, mydev->jb.tail);
+	n = minivosc_capture_bytes(mydev, count, 0, &got);
+	minivosc_convert_out(mydev, n);
+	mydev->stats.bytes += n;
+	trace_minivosc_fill(mydev->dev_id, n, mydev->dma.pos);
+	minivosc_ptr_update(mydev, n);
+	if (n == 0) {
+		// nothing to deliver: sleep until a producer kicks us
+		if (minivosc_idle_enter(mydev))
+			return;
 		goto timer_restart;
 	}
-	mydev->last_sequence = mydev->back_buffer.sequence;
-
-	// FILL BUFFER HERE
-	minivosc_fill_capture_buf(mydev, count);
-	timeout_ms = 100;
+	// got data, next batch is due in one period
+	timeout_ms = max(mydev->pcm_period_size * 1000 / mydev->pcm_bps, 1U);
 
 	if (mydev->irq_pos >= mydev->period_size_frac)
 	{
 		// dbg2("*	: mydev->irq_pos >= mydev->period_size_frac %d, calling snd_pcm_period_elapsed", mydev->period_size_frac);
 		mydev->irq_pos %= mydev->period_size_frac;
-		snd_pcm_period_elapsed(mydev->substream);
+		// the app asked for no period wakeups and polls the pointer instead
+		if (!mydev->substream->runtime->no_period_wakeup) {
+			minivosc_ptr_sync(mydev);
+			trace_minivosc_period_elapsed(mydev->dev_id, mydev->dma.pos);
+			snd_pcm_period_elapsed(mydev->substream);
+		}
 	}
 
 timer_restart:
@@ -754,62 +1856,1048 @@ timer_restart:
 	return;
 }
 
-static void minivosc_fill_capture_buf(struct minivosc_device *mydev, unsigned int bytes)
+/*
+ * hrtimer clock: fires on period boundaries. The expiry is always computed
+ * from the stream start and the total frame count, so the rounding of
+ * a single period to whole nanoseconds never accumulates.
+ */
+static ktime_t minivosc_hrtimer_expiry(struct minivosc_device *mydev, u64 frames)
+{
+	struct snd_pcm_runtime *runtime = mydev->substream->runtime;
+
+	return ktime_add_ns(mydev->hr_base, div_u64(frames * NSEC_PER_SEC, runtime->rate));
+}
+
+static void minivosc_hrtimer_start(struct minivosc_device *mydev)
 {
-	char *dst = mydev->substream->runtime->dma_area;
-	float wrdat;
-	unsigned j;
-	unsigned int dst_off = mydev->buf_pos; // buf_pos is in bytes, not in samples !
+	struct snd_pcm_runtime *runtime = mydev->substream->runtime;
 
-	if (bytes > DC_PCM_CHUNK_DATA_LEN)
-		bytes = DC_PCM_CHUNK_DATA_LEN;
+	mydev->hr_base = ktime_get();
+	mydev->hr_frames = 0;
+	mydev->idle_periods = 0;
+	clear_bit(0, &mydev->idle);
+	hrtimer_start(&mydev->hrtimer, minivosc_hrtimer_expiry(mydev, runtime->period_size), HRTIMER_MODE_ABS);
+}
 
-	dbg2("Writing sequence %d [ %x %x %x ... %x %x %x]", mydev->back_buffer.sequence,
-			mydev->back_buffer.data[0] & 0xff,\
-			mydev->back_buffer.data[1] & 0xff,\
-			mydev->back_buffer.data[2] & 0xff,\
-			mydev->back_buffer.data[DC_PCM_CHUNK_DATA_LEN -3]&0xff,\
-			mydev->back_buffer.data[DC_PCM_CHUNK_DATA_LEN -2]&0xff,\
-			mydev->back_buffer.data[DC_PCM_CHUNK_DATA_LEN -1]&0xff);
+// called from trigger with the stream lock held, so must not wait
+// for the callback (it may be waiting for the same lock)
+static void minivosc_hrtimer_stop(struct minivosc_device *mydev)
+{
+	dbg2("minivosc_hrtimer_stop");
+	hrtimer_try_to_cancel(&mydev->hrtimer);
+}
 
-	for (j=0; j < bytes; j++) {
-		dst[mydev->buf_pos++] = mydev->back_buffer.data[j];
-		if (mydev->buf_pos >= mydev->pcm_buffer_size) {
-			mydev->buf_pos = 0;
-		}
+static void minivosc_hrtimer_sync(struct minivosc_device *mydev)
+{
+	clear_bit(0, &mydev->idle);
+	hrtimer_cancel(&mydev->hrtimer);
+	tasklet_kill(&mydev->period_tasklet);
+}
+
+// data landed while idle: restart the period grid with the first period due now
+static void minivosc_hrtimer_kick(struct minivosc_device *mydev)
+{
+	ktime_t now = ktime_get();
+
+	if (!ACCESS_ONCE(mydev->running))
+		return;
+	mydev->hr_base = ktime_sub_ns(now, div_u64((u64)mydev->pcm_period_size * NSEC_PER_SEC, mydev->pcm_bps));
+	mydev->hr_frames = 0;
+	mydev->idle_periods = 0;
+	hrtimer_start(&mydev->hrtimer, now, HRTIMER_MODE_ABS);
+}
+
+// deliver one period worth of audio, concealed if the sender is behind;
+// returns the bytes that came from the source
+static unsigned int minivosc_capture_period(struct minivosc_device *mydev)
+{
+	unsigned int got;
+
+	minivosc_capture_bytes(mydev, mydev->pcm_period_size, 1, &got);
+	minivosc_convert_out(mydev, mydev->pcm_period_size);
+	mydev->stats.bytes += mydev->pcm_period_size;
+	trace_minivosc_fill(mydev->dev_id, mydev->pcm_period_size, mydev->dma.pos);
+	minivosc_ptr_update(mydev, mydev->pcm_period_size);
+	return got;
+}
+
+static enum hrtimer_restart minivosc_hrtimer_function(struct hrtimer *timer)
+{
+	struct minivosc_device *mydev = container_of(timer, struct minivosc_device, hrtimer);
+	struct snd_pcm_runtime *runtime;
+	ktime_t now, next;
+	unsigned int periods = 0;
+
+	if (!mydev->running)
+		return HRTIMER_NORESTART;
+
+	runtime = mydev->substream->runtime;
+	now = hrtimer_cb_get_time(timer);
+	trace_minivosc_timer_fire(mydev->dev_id, hrtimer_get_expires(timer), now);
+	minivosc_stats_tick(mydev, ktime_to_ns(ktime_sub(now, hrtimer_get_expires(timer))));
+
+	// catch up on periods we slept through, but never lap the buffer
+	do {
+		if (minivosc_capture_period(mydev))
+			mydev->idle_periods = 0;
+		else
+			mydev->idle_periods++;
+		mydev->hr_frames += runtime->period_size;
+		next = minivosc_hrtimer_expiry(mydev, mydev->hr_frames + runtime->period_size);
+	} while (ktime_compare(next, now) <= 0 && ++periods < runtime->periods);
+
+	if (ktime_compare(next, now) <= 0) {
+		dbg2("%s: lost %u periods, resyncing clock", __func__, runtime->periods);
+		mydev->hr_base = now;
+		mydev->hr_frames = 0;
+		next = minivosc_hrtimer_expiry(mydev, runtime->period_size);
+	}
+
+	// snd_pcm_period_elapsed takes the stream lock, which _trigger holds
+	// while cancelling us - hand it off like dummy.c does
+	if (!runtime->no_period_wakeup) {
+		minivosc_ptr_sync(mydev);
+		tasklet_schedule(&mydev->period_tasklet);
+	}
+
+	// a buffer full of concealment/silence and still no sender: stop
+	if (mydev->idle_periods >= runtime->periods && minivosc_idle_enter(mydev))
+		return HRTIMER_NORESTART;
+
+	hrtimer_set_expires(timer, next);
+	return HRTIMER_RESTART;
+}
+
+static void minivosc_period_tasklet(unsigned long data)
+{
+	struct minivosc_device *mydev = (struct minivosc_device *)data;
+
+	if (mydev->running) {
+		trace_minivosc_period_elapsed(mydev->dev_id, mydev->dma.pos);
+		snd_pcm_period_elapsed(mydev->substream);
+	}
+}
+
+/*
+ * Idle clock. Instead of polling an empty source, the clock stops and
+ * the producer restarts it when a chunk lands, so idle mics cost no
+ * wakeups and new data doesn't wait for the next poll. The mmap ring
+ * can't signal new data, so the clock keeps polling while it is open.
+ */
+// returns 1 if the clock may stop, 0 if data raced in and it must go on
+static int minivosc_idle_enter(struct minivosc_device *mydev)
+{
+	struct minivosc_jb *jb = &mydev->jb;
+
+	if (ACCESS_ONCE(mydev->ring.active))
+		return 0;
+
+	set_bit(0, &mydev->idle);
+	// pairs with smp_mb() in minivosc_kick: either we see the new
+	// chunk here, or the producer sees the idle bit
+	smp_mb();
+	if (ACCESS_ONCE(jb->head) - jb->tail < jb->target && !ACCESS_ONCE(mydev->ring.active)) {
+		dbg2("%s: no producer, clock idle", __func__);
+		return 1;
+	}
+
+	// a producer that cleared the bit first restarts the clock itself
+	return !test_and_clear_bit(0, &mydev->idle);
+}
+
+// producer side, after publishing new data
+static void minivosc_kick(struct minivosc_device *mydev)
+{
+	smp_mb();
+	if (test_bit(0, &mydev->idle) && test_and_clear_bit(0, &mydev->idle))
+		mydev->timer_ops->kick(mydev);
+}
+
+/*
+ * Timestamps: next_ts follows the capture time of the source position,
+ * which is the audio about to land at dma.pos. Written by the clock only,
+ * read under ts_seq from pointer and get_time_info.
+ */
+static inline s64 minivosc_src_ns(unsigned int bytes)
+{
+	return (s64)bytes * (NSEC_PER_SEC / (DC_PCM_RATE * DC_PCM_SAMPLE_BYTES));
+}
+
+// 'from' is the capture time of audio just delivered, 'ns' its duration
+static void minivosc_ts_update(struct minivosc_device *mydev, s64 from, s64 ns)
+{
+	write_seqcount_begin(&mydev->ts_seq);
+	if (!mydev->first_ts)
+		mydev->first_ts = from;
+	mydev->next_ts = from + ns;
+	write_seqcount_end(&mydev->ts_seq);
+}
+
+static s64 minivosc_pcm_ts(struct minivosc_device *mydev, s64 *first)
+{
+	unsigned int seq;
+	s64 ts;
+
+	do {
+		seq = read_seqcount_begin(&mydev->ts_seq);
+		ts = mydev->next_ts;
+		if (first)
+			*first = mydev->first_ts;
+	} while (read_seqcount_retry(&mydev->ts_seq, seq));
+
+	return ts;
+}
+
+/*
+ * Pointer interpolation: a fill writes a batch at once, the pointer then
+ * moves through it at the nominal rate instead of jumping, but never past
+ * what was written. It trails the written data by at most a period, and
+ * not at all right after a period is reported elapsed: the wakeup must
+ * find that period available.
+ */
+static u64 minivosc_ptr_at(struct minivosc_device *mydev, u64 base, ktime_t t, u64 written, ktime_t now)
+{
+	s64 elapsed = ktime_to_ns(ktime_sub(now, t));
+	u64 pos;
+
+	if (elapsed <= 0)
+		return base;
+	// a stalled stream would only be clamped anyway
+	pos = base + div_u64((u64)min_t(s64, elapsed, NSEC_PER_SEC) * mydev->pcm_bps, NSEC_PER_SEC);
+	return min(pos, written);
+}
+
+// the clock wrote 'bytes' more to the dma area
+static void minivosc_ptr_update(struct minivosc_device *mydev, unsigned int bytes)
+{
+	ktime_t now = ktime_get();
+	u64 cur = minivosc_ptr_at(mydev, mydev->ptr_base, mydev->ptr_time, mydev->written, now);
+	u64 written = mydev->written + bytes;
+
+	if (written - cur > mydev->pcm_period_size)
+		cur = written - mydev->pcm_period_size;
+
+	write_seqcount_begin(&mydev->ts_seq);
+	mydev->written = written;
+	mydev->ptr_base = cur;
+	mydev->ptr_time = now;
+	write_seqcount_end(&mydev->ts_seq);
+}
+
+// a period elapsed: report everything written
+static void minivosc_ptr_sync(struct minivosc_device *mydev)
+{
+	write_seqcount_begin(&mydev->ts_seq);
+	mydev->ptr_base = mydev->written;
+	mydev->ptr_time = ktime_get();
+	write_seqcount_end(&mydev->ts_seq);
+}
+
+// position in the dma area to report; lag_ns: how far it trails dma.pos
+static unsigned int minivosc_ptr_read(struct minivosc_device *mydev, u64 *lag_ns)
+{
+	unsigned int seq;
+	u64 base, written, pos;
+	ktime_t t;
+	u32 rem;
+
+	if (!mydev->ptr_interp || !mydev->pcm_bps) {
+		*lag_ns = 0;
+		return mydev->dma.pos;
+	}
+
+	do {
+		seq = read_seqcount_begin(&mydev->ts_seq);
+		base = mydev->ptr_base;
+		t = mydev->ptr_time;
+		written = mydev->written;
+	} while (read_seqcount_retry(&mydev->ts_seq, seq));
+
+	pos = minivosc_ptr_at(mydev, base, t, written, ktime_get());
+	*lag_ns = div_u64((written - pos) * NSEC_PER_SEC, mydev->pcm_bps);
+	div_u64_rem(pos, mydev->pcm_buffer_size, &rem);
+	return rem;
+}
+
+/*
+ * Packet loss concealment. Chunks missing from the sequence are replaced
+ * by the same amount of synthesized audio before the next chunk plays,
+ * so the timeline stays intact; clock ticks the source can't serve are
+ * concealed the same way. Those count against a gap: an outage that was
+ * already filled in tick by tick is not concealed a second time.
+ */
+// check the chunk about to start playing; schedules concealment for a gap
+static int minivosc_src_gap(struct minivosc_device *mydev, const struct minivosc_chunk *chunk)
+{
+	struct minivosc_jb *jb = &mydev->jb;
+	int missing = (int)(chunk->sequence - jb->play_sequence - 1);
+	unsigned int owed, padded = mydev->padded;
+
+	mydev->padded = 0;
+
+	// the first chunk, or the sender restarted
+	if (!jb->play_sequence || missing <= 0 || missing >= MINIVOSC_JB_SLOTS)
+		return 0;
+
+	mydev->stats.gaps++;
+	mydev->stats.lost += missing;
+	jb->play_sequence = chunk->sequence - 1;
+	dbg2("sequence gap: %d chunks lost before %u", missing, chunk->sequence);
+
+	// only the part of the gap underruns haven't covered in real time;
+	// anything more would stay on as capture latency
+	owed = missing * chunk->len;
+	if (!mydev->plc_frames || owed <= padded)
+		return 0;
+
+	mydev->plc_bytes = min(owed - padded, mydev->pcm_buffer_size);
+	return 1;
+}
+
+// write up to 'bytes' of concealment into the sink
+static unsigned int minivosc_conceal_bytes(struct minivosc_device *mydev, unsigned int bytes)
+{
+	unsigned int frame = ACCESS_ONCE(mydev->jb.last_len);
+	unsigned int hold, fade, done = 0;
+
+	if (!frame || ACCESS_ONCE(mydev->ring.active))
+		frame = mydev->pcm_period_size;
+	frame /= DC_PCM_SAMPLE_BYTES;
+
+	// the first missing frame plays at full level
+	hold = frame;
+	fade = (mydev->plc_frames - 1) * frame;
+
+	bytes &= ~(DC_PCM_SAMPLE_BYTES - 1);
+	while (done < bytes) {
+		unsigned int n = min(minivosc_dma_span(mydev->sink), bytes - done);
+
+		minivosc_plc_conceal(&mydev->plc, (s16 *)(mydev->sink->area + mydev->sink->pos),
+		                     n / DC_PCM_SAMPLE_BYTES, hold, fade);
+		minivosc_dma_advance(mydev->sink, n);
+		done += n;
 	}
 
-	if (mydev->silent_size >= mydev->pcm_buffer_size)
+	mydev->stats.concealed += done / DC_PCM_SAMPLE_BYTES;
+	// concealment stands in for the missing audio, time moves on
+	if (mydev->next_ts)
+		minivosc_ts_update(mydev, mydev->next_ts, minivosc_src_ns(done));
+	return done;
+}
+
+// real audio was written just before dma.pos
+static void minivosc_conceal_good(struct minivosc_device *mydev, char *pcm, unsigned int bytes)
+{
+	if (mydev->plc_frames)
+		minivosc_plc_good(&mydev->plc, (s16 *)pcm, bytes / DC_PCM_SAMPLE_BYTES);
+}
+
+/*
+ * Format conversion: when the app didn't open S16_LE mono, the fill path
+ * writes into mydev->shadow, a ring of the same frames in S16 mono, and
+ * each fill is converted to the real dma area right after, so both rings
+ * stay at the same frame position.
+ */
+// 'bytes' (S16 mono) were just written, ending at dma.pos
+static void minivosc_convert_out(struct minivosc_device *mydev, unsigned int bytes)
+{
+	char *area = mydev->substream->runtime->dma_area;
+	unsigned int frame_bytes = minivosc_convert_frame_bytes(mydev->conv_fmt, mydev->conv_channels);
+	unsigned int start, n;
+
+	if (!mydev->shadow || !bytes)
 		return;
 
-	// NOTE: usually, the code returns by now -
-	// - it doesn't even execute past this point!
-	// from here on, apparently silent_size should be handled..
+	bytes = min(bytes, mydev->dma.size);
+	start = (mydev->dma.pos + mydev->dma.size - bytes) % mydev->dma.size;
+	while (bytes) {
+		n = min(bytes, mydev->dma.size - start);
+		minivosc_convert(area + start / DC_PCM_SAMPLE_BYTES * frame_bytes,
+		                 mydev->shadow + start / DC_PCM_SAMPLE_BYTES, n / DC_PCM_SAMPLE_BYTES,
+		                 mydev->conv_fmt, mydev->conv_channels);
+		bytes -= n;
+		start = 0;
+	}
+}
+
+/*
+ * Rate conversion: above 16kHz the capture sources, concealment and
+ * pre-roll all write 16kHz into the stage, which minivosc_capture_bytes
+ * sizes to exactly what the wanted output needs and the polyphase
+ * resampler then empties into the dma area.
+ */
+// resample the 'in_bytes' in the stage to up to 'bytes' at dma.pos; returns the bytes written
+static unsigned int minivosc_stage_out(struct minivosc_device *mydev, unsigned int in_bytes, unsigned int bytes)
+{
+	const s16 *in = (const s16 *)mydev->stage.area;
+	unsigned int in_len = in_bytes / DC_PCM_SAMPLE_BYTES, used, n, out = 0;
+
+	bytes &= ~(DC_PCM_SAMPLE_BYTES - 1);
+	while (out < bytes) {
+		unsigned int span = min(minivosc_dma_span(&mydev->dma), bytes - out);
+
+		n = minivosc_pp_run(&mydev->pp, in, in_len, &used,
+		                    (s16 *)(mydev->dma.area + mydev->dma.pos), span / DC_PCM_SAMPLE_BYTES);
+		in += used;
+		in_len -= used;
+		minivosc_dma_advance(&mydev->dma, n * DC_PCM_SAMPLE_BYTES);
+		out += n * DC_PCM_SAMPLE_BYTES;
+		if (n < span / DC_PCM_SAMPLE_BYTES)
+			break;
+	}
 
-	if (mydev->silent_size + bytes > mydev->pcm_buffer_size)
-		bytes = mydev->pcm_buffer_size - mydev->silent_size;
+	return out;
+}
 
-	wrdat = -0.2; // value to copy, instead of 0 for silence (if needed)
-	for (;;) {
-		unsigned int size = bytes;
-		unsigned int dpos = 0;
-		dbg2("_ clearrr..	%d", bytes);
-		if (dst_off + size > mydev->pcm_buffer_size)
-			size = mydev->pcm_buffer_size - dst_off;
+/*
+ * Pre-roll: while no capture runs the producer also keeps the most recent
+ * audio in jb->hist. On start the newest period of it goes straight into
+ * the dma area and the app is woken at once, instead of waiting for the
+ * clock and the jitter buffer to fill.
+ */
+// called from trigger, before the clock starts
+static void minivosc_preroll(struct minivosc_device *mydev)
+{
+	struct minivosc_jb *jb = &mydev->jb;
+	int ms = min(preroll_ms, 1000);
+	unsigned int bytes = 0, ofs, first, max = mydev->pcm_period_size;
+	char *out;
+	s64 end_ts = 0;
+
+	// at most one period of output, which may be less input
+	if (mydev->sink != &mydev->dma) {
+		max = min(minivosc_pp_need(&mydev->pp, max / DC_PCM_SAMPLE_BYTES),
+		          (unsigned int)MINIVOSC_STAGE_SAMPLES) * DC_PCM_SAMPLE_BYTES;
+		mydev->stage.pos = 0;
+	}
+	out = mydev->sink->area + mydev->sink->pos;
 
-		//memset(dst + dst_off, 255, size); //0, size);
-		while (dpos < size)
-		{
-			memcpy(dst + dst_off + dpos, &wrdat, sizeof(wrdat));
-			dpos += sizeof(wrdat);
-			if (dpos >= size) break;
+	spin_lock(&jb->push_lock);
+	jb->hist_on = 0;
+
+	if (ms > 0 && jb->hist_head && time_before(jiffies, jb->hist_jiffies + msecs_to_jiffies(ms))) {
+		bytes = min3((unsigned int)(ms * (DC_PCM_RATE / 1000) * DC_PCM_SAMPLE_BYTES),
+		             jb->hist_head, max);
+		bytes &= ~(DC_PCM_SAMPLE_BYTES - 1);
+
+		ofs = (jb->hist_head - bytes) & (MINIVOSC_HIST_SIZE - 1);
+		first = min(bytes, MINIVOSC_HIST_SIZE - ofs);
+		minivosc_dma_copy(mydev->sink, jb->hist + ofs, first);
+		minivosc_dma_copy(mydev->sink, jb->hist, bytes - first);
+		end_ts = jb->hist_ts;
+	}
+
+	// whatever is queued is older than what we just delivered, and a
+	// ring that filled up while we were stopped has refused everything
+	// newer; the clock isn't running, so the tail is ours to move
+	if (bytes || jb->head - jb->tail >= MINIVOSC_JB_SLOTS) {
+		jb->read_ofs = 0;
+		ACCESS_ONCE(jb->tail) = jb->head;
+	}
+	spin_unlock(&jb->push_lock);
+
+	if (!bytes)
+		return;
+
+	dbg2("%s: %u bytes", __func__, bytes);
+	minivosc_conceal_good(mydev, out, bytes);
+	minivosc_ts_update(mydev, end_ts - minivosc_src_ns(bytes), minivosc_src_ns(bytes));
+	if (mydev->sink != &mydev->dma)
+		bytes = minivosc_stage_out(mydev, bytes, mydev->pcm_period_size);
+	minivosc_convert_out(mydev, bytes);
+	mydev->stats.bytes += bytes;
+	trace_minivosc_fill(mydev->dev_id, bytes, mydev->dma.pos);
+
+	// available right away, no interpolation
+	write_seqcount_begin(&mydev->ts_seq);
+	mydev->written = bytes;
+	mydev->ptr_base = bytes;
+	mydev->ptr_time = ktime_get();
+	write_seqcount_end(&mydev->ts_seq);
+
+	// trigger holds the stream lock, let the tasklet report it
+	if (bytes == mydev->pcm_period_size && !mydev->substream->runtime->no_period_wakeup)
+		tasklet_schedule(&mydev->period_tasklet);
+}
+
+/*
+ * Capture sources: the mmap ring while it is open, the jitter buffer
+ * otherwise. _peek returns the contiguous bytes readable in place,
+ * _consume releases them; a chunk may be spread over several ticks.
+ */
+static unsigned int minivosc_src_peek(struct minivosc_device *mydev, const char **data)
+{
+	const struct minivosc_chunk *chunk;
+
+	// concealment for a gap comes first
+	if (mydev->plc_bytes)
+		return 0;
+
+	if (ACCESS_ONCE(mydev->ring.active))
+		return minivosc_ring_peek(&mydev->ring, data);
+
+	chunk = minivosc_jb_peek(&mydev->jb);
+	if (!chunk)
+		return 0;
+
+	if (mydev->jb.read_ofs == 0 && minivosc_src_gap(mydev, chunk))
+		return 0;
+
+	dbg2("Writing sequence %d [%u.. of %u]", chunk->sequence, mydev->jb.read_ofs, chunk->len);
+	*data = chunk->data + mydev->jb.read_ofs;
+	return chunk->len - mydev->jb.read_ofs;
+}
+
+static void minivosc_src_consume(struct minivosc_device *mydev, unsigned int bytes)
+{
+	struct minivosc_jb *jb = &mydev->jb;
+	const struct minivosc_chunk *chunk;
+
+	if (ACCESS_ONCE(mydev->ring.active)) {
+		minivosc_ring_consume(&mydev->ring, bytes);
+		// the ring carries no timestamps, the producer writes as it captures
+		minivosc_ts_update(mydev, ktime_to_ns(ktime_get()) - minivosc_src_ns(minivosc_ring_fill(&mydev->ring) + bytes),
+		                   minivosc_src_ns(bytes));
+		return;
+	}
+
+	chunk = &jb->slots[jb->tail & MINIVOSC_JB_MASK];
+	jb->read_ofs += bytes;
+	minivosc_ts_update(mydev, chunk->tstamp + minivosc_src_ns(jb->read_ofs - bytes), minivosc_src_ns(bytes));
+	if (jb->read_ofs >= chunk->len)
+		minivosc_jb_pop(jb);
+}
+
+// fill level and the level we steer to, in bytes; 0 while (re)buffering
+static u32 minivosc_src_fill(struct minivosc_device *mydev, u32 *target)
+{
+	struct minivosc_jb *jb = &mydev->jb;
+	u32 len;
+
+	if (ACCESS_ONCE(mydev->ring.active)) {
+		*target = dc_ring_watermark(&mydev->ring);
+		return minivosc_ring_fill(&mydev->ring);
+	}
+
+	if (!jb->primed)
+		return 0;
+
+	// chunks arrive whole and leave gradually, so the level swings by
+	// one chunk; aim for the middle of the swing
+	len = ACCESS_ONCE(jb->last_len);
+	*target = jb->target * len - len / 2;
+	return minivosc_jb_bytes(jb);
+}
+
+// clock drift compensation: steer the resampler by the source fill level
+static void minivosc_drift_tick(struct minivosc_device *mydev)
+{
+	u32 target, fill = minivosc_src_fill(mydev, &target);
+
+	if (fill == 0)
+		return;
+
+	minivosc_rs_set_ppm(&mydev->rs, minivosc_drift_update(&mydev->drift, fill, target));
+}
+
+// resample straight from the source into the sink
+static unsigned int minivosc_capture_resampled(struct minivosc_device *mydev, unsigned int bytes)
+{
+	const char *data;
+	unsigned int n, copied = 0;
+
+	minivosc_drift_tick(mydev);
+
+	while (copied < bytes && (n = minivosc_src_peek(mydev, &data)) != 0) {
+		unsigned int used, produced;
+		unsigned int span = min(minivosc_dma_span(mydev->sink), bytes - copied);
+		char *out = mydev->sink->area + mydev->sink->pos;
+
+		produced = minivosc_rs_run(&mydev->rs, (const s16 *)data, n / DC_PCM_SAMPLE_BYTES, &used,
+		                           (s16 *)out, span / DC_PCM_SAMPLE_BYTES);
+		minivosc_src_consume(mydev, used * DC_PCM_SAMPLE_BYTES);
+		minivosc_conceal_good(mydev, out, produced * DC_PCM_SAMPLE_BYTES);
+		minivosc_dma_advance(mydev->sink, produced * DC_PCM_SAMPLE_BYTES);
+		copied += produced * DC_PCM_SAMPLE_BYTES;
+
+		if (span < DC_PCM_SAMPLE_BYTES)
+			break;
+	}
+
+	return copied;
+}
+
+static unsigned int minivosc_capture_copy(struct minivosc_device *mydev, unsigned int bytes)
+{
+	const char *data;
+	unsigned int n, copied = 0;
+
+	while (copied < bytes && (n = minivosc_src_peek(mydev, &data)) != 0) {
+		char *out = mydev->sink->area + mydev->sink->pos;
+
+		// one dma span at a time so concealment sees contiguous audio
+		n = min3(n, bytes - copied, minivosc_dma_span(mydev->sink));
+		minivosc_dma_copy(mydev->sink, data, n);
+		minivosc_src_consume(mydev, n);
+		minivosc_conceal_good(mydev, out, n);
+		copied += n;
+	}
+
+	return copied;
+}
+
+// pull up to 'bytes' from the source into the sink; returns the bytes written
+static unsigned int minivosc_capture_src(struct minivosc_device *mydev, unsigned int bytes)
+{
+	unsigned int n, copied = 0;
+
+	while (copied < bytes) {
+		if (mydev->plc_bytes) {
+			n = minivosc_conceal_bytes(mydev, min(mydev->plc_bytes, bytes - copied));
+			if (n == 0)
+				break;
+			mydev->plc_bytes -= min(n, mydev->plc_bytes);
+			copied += n;
+			continue;
 		}
-		mydev->silent_size += size;
-		bytes -= size;
-		if (!bytes)
+
+		if (mydev->drift_comp)
+			copied += minivosc_capture_resampled(mydev, bytes - copied);
+		else
+			copied += minivosc_capture_copy(mydev, bytes - copied);
+
+		// stopped short for any reason but a gap: the source is dry
+		if (!mydev->plc_bytes)
 			break;
-		dst_off = 0;
 	}
+
+	return copied;
+}
+
+// conceal what the source couldn't deliver of 'bytes'
+static unsigned int minivosc_capture_pad(struct minivosc_device *mydev, unsigned int copied, unsigned int bytes)
+{
+	if (copied < bytes) {
+		mydev->padded += bytes - copied;
+		if (mydev->plc_frames)
+			copied += minivosc_conceal_bytes(mydev, bytes - copied);
+		if (copied < bytes)
+			minivosc_dma_silence(mydev->sink, bytes - copied);
+		mydev->stats.underruns++;
+	}
+	return bytes;
+}
+
+/*
+ * Pull up to 'bytes' at the app's rate into the dma area, through the
+ * resampler if there is one; with 'pad' source shortfalls are concealed
+ * and exactly 'bytes' are written. Returns the bytes written, *got the
+ * part of it (in source bytes) that came from the source.
+ */
+static unsigned int minivosc_capture_bytes(struct minivosc_device *mydev, unsigned int bytes,
+                                           int pad, unsigned int *got)
+{
+	unsigned int in, n, done, out = 0;
+
+	if (mydev->sink == &mydev->dma) {
+		*got = minivosc_capture_src(mydev, bytes);
+		return pad ? minivosc_capture_pad(mydev, *got, bytes) : *got;
+	}
+
+	*got = 0;
+	while (out < bytes) {
+		// exactly the input these outputs need, so the stage ends up empty
+		in = min(minivosc_pp_need(&mydev->pp, (bytes - out) / DC_PCM_SAMPLE_BYTES),
+		         (unsigned int)MINIVOSC_STAGE_SAMPLES) * DC_PCM_SAMPLE_BYTES;
+		mydev->stage.pos = 0;
+		n = minivosc_capture_src(mydev, in);
+		*got += n;
+		if (pad)
+			n = minivosc_capture_pad(mydev, n, in);
+
+		done = minivosc_stage_out(mydev, n, bytes - out);
+		out += done;
+		if (n < in || !done)
+			break;
+	}
+
+	return out;
+}
+
+/*
+ *
+ * Virtual speaker (playback substream)
+ *
+ */
+static int minivosc_pb_init(struct minivosc_playback *pb)
+{
+	pb->frame = kmalloc(sizeof(*pb->frame), GFP_KERNEL);
+	if (!pb->frame)
+		return -ENOMEM;
+	INIT_WORK(&pb->work, minivosc_pb_work);
+	return 0;
+}
+
+// the card is going away, no stream is open
+static void minivosc_pb_free(struct minivosc_playback *pb)
+{
+	if (!pb->frame)
+		return;
+	cancel_work_sync(&pb->work);
+	kfree(pb->frame);
+}
+
+static void minivosc_pb_send(struct minivosc_device *mydev, const struct minivosc_chunk *f)
+{
+	struct minivosc_playback *pb = &mydev->pb;
+	struct sk_buff *skb;
+	void *hdr;
+
+	skb = genlmsg_new(nla_total_size(f->len) + 4 * nla_total_size(sizeof(u64)), GFP_KERNEL);
+	if (!skb)
+		return;
+
+	hdr = genlmsg_put(skb, 0, 0, &dc_genl_family, 0, DC_GENL_CMD_PLAYBACK);
+	if (!hdr)
+		goto EARLY_OUT;
+
+	if (nla_put_u32(skb, DC_GENL_ATTR_CARD, mydev->dev_id) ||
+	    nla_put_u32(skb, DC_GENL_ATTR_PCM_SEQUENCE, f->sequence) ||
+	    nla_put_u32(skb, DC_GENL_ATTR_PCM_SAMPLES, f->len / DC_PCM_SAMPLE_BYTES) ||
+	    nla_put_u64(skb, DC_GENL_ATTR_PCM_TIMESTAMP, (u64)f->tstamp) ||
+	    nla_put(skb, DC_GENL_ATTR_PCM_DATA, f->len, f->data))
+		goto EARLY_OUT;
+
+	genlmsg_end(skb, hdr);
+	// -ESRCH: nobody listens, the audio just plays into the void
+	if (genlmsg_multicast(&dc_genl_family, skb, 0, DC_GENL_GRP_PLAYBACK, GFP_KERNEL) == 0)
+		pb->sent++;
+	return;
+
+EARLY_OUT:
+	nlmsg_free(skb);
+}
+
+// the next period of the dma area has played: send it to the reader,
+// or, when we are too far behind for it to still be there, skip it
+static void minivosc_pb_period(struct minivosc_device *mydev, int send)
+{
+	struct minivosc_playback *pb = &mydev->pb;
+	struct minivosc_chunk *f = pb->frame;
+	const char *area = pb->substream->runtime->dma_area;
+	unsigned int done = 0, len, first;
+
+	while (done < pb->period_size) {
+		len = min_t(unsigned int, pb->period_size - done, DC_PCM_FRAME_MAX_LEN);
+		pb->sequence++;
+
+		if (send) {
+			f->sequence = pb->sequence;
+			f->len = len;
+			f->tstamp = pb->start_ts + minivosc_src_ns(pb->played + done);
+			first = min(len, pb->buffer_size - pb->pos);
+			memcpy(f->data, area + pb->pos, first);
+			memcpy(f->data + first, area, len - first);
+			minivosc_pb_send(mydev, f);
+		} else {
+			// the sequence gap tells the reader
+			pb->drops++;
+		}
+
+		pb->pos = (pb->pos + len) % pb->buffer_size;
+		done += len;
+	}
+	pb->played += pb->period_size;
+}
+
+// send what the timer says has played, then report the new hw pointer:
+// the application may only refill a period once it has been copied out
+static void minivosc_pb_work(struct work_struct *work)
+{
+	struct minivosc_playback *pb = container_of(work, struct minivosc_playback, work);
+	struct minivosc_device *mydev = container_of(pb, struct minivosc_device, pb);
+	unsigned int periods = atomic_xchg(&pb->due, 0);
+	unsigned int fit = pb->buffer_size / pb->period_size;
+
+	if (!periods)
+		return;
+
+	// more than a buffer behind: the oldest periods were already overwritten
+	for (; periods > fit && ACCESS_ONCE(pb->running); periods--)
+		minivosc_pb_period(mydev, 0);
+	for (; periods && ACCESS_ONCE(pb->running); periods--)
+		minivosc_pb_period(mydev, 1);
+
+	if (ACCESS_ONCE(pb->running))
+		snd_pcm_period_elapsed(pb->substream);
+}
+
+static enum hrtimer_restart minivosc_pb_timer(struct hrtimer *timer)
+{
+	struct minivosc_playback *pb = container_of(timer, struct minivosc_playback, timer);
+	u64 periods;
+
+	if (!ACCESS_ONCE(pb->running))
+		return HRTIMER_NORESTART;
+
+	// one period per interval that passed, even if we fired late
+	periods = hrtimer_forward_now(timer, pb->period_time);
+	atomic_add((int)periods, &pb->due);
+	schedule_work(&pb->work);
+	return HRTIMER_RESTART;
+}
+
+// wait for a running timer callback and work item, and forget what was due
+static void minivosc_pb_sync(struct minivosc_playback *pb)
+{
+	hrtimer_cancel(&pb->timer);
+	cancel_work_sync(&pb->work);
+	atomic_set(&pb->due, 0);
+}
+
+static int minivosc_pb_open(struct snd_pcm_substream *ss)
+{
+	struct minivosc_device *mydev = ss->private_data;
+	struct minivosc_playback *pb = &mydev->pb;
+	int ret;
+
+	dbg("%s", __func__);
+	ss->runtime->hw = minivosc_playback_hw;
+	ss->runtime->hw.buffer_bytes_max = MAX_BUFFER;
+	ss->runtime->hw.period_bytes_max = MAX_BUFFER / 2;
+	ret = minivosc_pcm_constraints(ss->runtime);
+	if (ret < 0)
+		return ret;
+
+	pb->substream = ss;
+	ss->runtime->private_data = mydev;
+	hrtimer_init(&pb->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	pb->timer.function = minivosc_pb_timer;
+	return 0;
+}
+
+static int minivosc_pb_close(struct snd_pcm_substream *ss)
+{
+	struct minivosc_device *mydev = ss->private_data;
+	struct minivosc_playback *pb = &mydev->pb;
+
+	dbg("%s", __func__);
+	minivosc_pb_sync(pb);
+	pb->substream = NULL;
+	dbg("	playback: frames sent=%lu dropped=%lu last-seq=%u", pb->sent, pb->drops, pb->sequence);
+	return 0;
+}
+
+static int minivosc_pb_hw_params(struct snd_pcm_substream *ss, struct snd_pcm_hw_params *hw_params)
+{
+	dbg("%s", __func__);
+	return snd_pcm_lib_malloc_pages(ss, params_buffer_bytes(hw_params));
+}
+
+static int minivosc_pb_hw_free(struct snd_pcm_substream *ss)
+{
+	struct minivosc_device *mydev = ss->private_data;
+
+	dbg("%s", __func__);
+	// the work copies out of the pages
+	minivosc_pb_sync(&mydev->pb);
+	return snd_pcm_lib_free_pages(ss);
+}
+
+static int minivosc_pb_prepare(struct snd_pcm_substream *ss)
+{
+	struct snd_pcm_runtime *runtime = ss->runtime;
+	struct minivosc_device *mydev = runtime->private_data;
+	struct minivosc_playback *pb = &mydev->pb;
+
+	dbg("%s()", __func__);
+	minivosc_pb_sync(pb);
+
+	pb->buffer_size = frames_to_bytes(runtime, runtime->buffer_size);
+	pb->period_size = frames_to_bytes(runtime, runtime->period_size);
+	pb->period_time = ns_to_ktime(div_u64((u64)runtime->period_size * NSEC_PER_SEC, runtime->rate));
+	pb->pos = 0;
+	pb->played = 0;
+	// a new stream starts over at 1, like senders do
+	pb->sequence = 0;
+	dbg2("	playback: buffer %u bytes, period %u bytes", pb->buffer_size, pb->period_size);
+	return 0;
+}
+
+static int minivosc_pb_trigger(struct snd_pcm_substream *ss, int cmd)
+{
+	struct minivosc_device *mydev = ss->private_data;
+	struct minivosc_playback *pb = &mydev->pb;
+	ktime_t now;
+
+	dbg("%s - trig %d", __func__, cmd);
+
+	switch (cmd) {
+	case SNDRV_PCM_TRIGGER_START:
+		now = ktime_get();
+		pb->start_ts = ktime_to_ns(now);
+		pb->running = 1;
+		hrtimer_start(&pb->timer, ktime_add(now, pb->period_time), HRTIMER_MODE_ABS);
+		return 0;
+	case SNDRV_PCM_TRIGGER_STOP:
+		pb->running = 0;
+		// trigger holds the stream lock, the work may be waiting for it;
+		// both see running cleared and stop on their own
+		hrtimer_try_to_cancel(&pb->timer);
+		return 0;
+	}
+	return -EINVAL;
+}
+
+static snd_pcm_uframes_t minivosc_pb_pointer(struct snd_pcm_substream *ss)
+{
+	struct minivosc_device *mydev = ss->private_data;
+
+	return bytes_to_frames(ss->runtime, ACCESS_ONCE(mydev->pb.pos));
+}
+
+/*
+ *
+ * Statistics
+ *
+ */
+// called by the capture clock at the start of every tick
+static void minivosc_stats_tick(struct minivosc_device *mydev, s64 late_ns)
+{
+	struct minivosc_stats *st = &mydev->stats;
+	unsigned int gen = ACCESS_ONCE(mydev->reset_gen);
+	unsigned int i, depth, late_us;
+
+	if (st->reset_seen != gen) {
+		memset(st, 0, sizeof(*st));
+		st->reset_seen = gen;
+	}
+
+	late_us = late_ns > 0 ? (unsigned int)min_t(s64, late_ns / NSEC_PER_USEC, UINT_MAX) : 0;
+	for (i = 0; i < MINIVOSC_LATE_BUCKETS - 1; i++)
+		if (late_us < minivosc_late_us[i])
+			break;
+	st->late[i]++;
+	if (late_us > st->late_max_us)
+		st->late_max_us = late_us;
+
+	depth = ACCESS_ONCE(mydev->jb.head) - mydev->jb.tail;
+	if (!st->timer_fires || depth < st->depth_min)
+		st->depth_min = depth;
+	if (depth > st->depth_max)
+		st->depth_max = depth;
+	st->depth_sum += depth;
+	st->timer_fires++;
+
+	minivosc_feedback_tick(mydev);
+}
+
+static void minivosc_proc_stats_read(struct snd_info_entry *entry, struct snd_info_buffer *buffer)
+{
+	struct minivosc_device *mydev = entry->private_data;
+	struct minivosc_stats st = mydev->stats;
+	unsigned int i;
+
+	// reset requested, the clock hasn't got to it yet
+	if (st.reset_seen != ACCESS_ONCE(mydev->reset_gen))
+		memset(&st, 0, sizeof(st));
+
+	snd_iprintf(buffer, "chunks received:  %lu\n", mydev->jb.chunks);
+	snd_iprintf(buffer, "chunks dropped:   %lu\n", mydev->jb.drops);
+	snd_iprintf(buffer, "chunk overruns:   %lu\n", mydev->jb.overruns);
+	snd_iprintf(buffer, "frames rejected:  %lu\n", mydev->jb.rejects);
+	snd_iprintf(buffer, "underruns:        %lu\n", st.underruns);
+	snd_iprintf(buffer, "sequence gaps:    %lu\n", st.gaps);
+	snd_iprintf(buffer, "chunks lost:      %lu\n", st.lost);
+	snd_iprintf(buffer, "concealed:        %lu samples\n", st.concealed);
+	snd_iprintf(buffer, "bytes delivered:  %llu\n", (unsigned long long)st.bytes);
+	snd_iprintf(buffer, "last sequence:    %u\n", mydev->jb.last_sequence);
+	snd_iprintf(buffer, "jb depth:         min %u avg %llu max %u chunks\n", st.depth_min,
+	            st.timer_fires ? (unsigned long long)div_u64(st.depth_sum, st.timer_fires) : 0ULL, st.depth_max);
+	snd_iprintf(buffer, "drift estimate:   %d ppm\n", mydev->drift.est_ppm);
+	snd_iprintf(buffer, "drift correction: %d ppm\n", mydev->drift.ppm);
+	snd_iprintf(buffer, "fill level:       %d bytes\n", mydev->drift.avg >> 4);
+	snd_iprintf(buffer, "playback frames:  %lu sent, %lu dropped\n", mydev->pb.sent, mydev->pb.drops);
+	snd_iprintf(buffer, "timer fires:      %lu\n", st.timer_fires);
+	snd_iprintf(buffer, "timer lateness:   max %u us\n", st.late_max_us);
+	for (i = 0; i < MINIVOSC_LATE_BUCKETS - 1; i++)
+		snd_iprintf(buffer, "  < %5u us:      %lu\n", minivosc_late_us[i], st.late[i]);
+	snd_iprintf(buffer, "  >= %4u us:      %lu\n", minivosc_late_us[i - 1], st.late[i]);
+}
+
+// echo reset > /proc/asound/cardN/stats
+static void minivosc_proc_stats_write(struct snd_info_entry *entry, struct snd_info_buffer *buffer)
+{
+	struct minivosc_device *mydev = entry->private_data;
+	char line[16];
+
+	if (snd_info_get_line(buffer, line, sizeof(line)) || strcmp(line, "reset"))
+		return;
+
+	spin_lock(&mydev->jb.push_lock);
+	mydev->jb.chunks = 0;
+	mydev->jb.drops = 0;
+	mydev->jb.overruns = 0;
+	mydev->jb.rejects = 0;
+	spin_unlock(&mydev->jb.push_lock);
+
+	ACCESS_ONCE(mydev->reset_gen) = mydev->reset_gen + 1;
+}
+
+/*
+ * Sender feedback: while capturing, every feedback_ms the state of the
+ * jitter buffer goes out on the DC_GENL_MCGRP_FEEDBACK multicast group,
+ * so senders can pace themselves to the target fill level.
+ */
+// called by the capture clock (atomic)
+static void minivosc_feedback_tick(struct minivosc_device *mydev)
+{
+	int ms = ACCESS_ONCE(feedback_ms);
+
+	if (ms <= 0 || time_before(jiffies, mydev->fb_next))
+		return;
+	mydev->fb_next = jiffies + msecs_to_jiffies(ms);
+	schedule_work(&mydev->fb_work);
+}
+
+static void minivosc_feedback_work(struct work_struct *work)
+{
+	struct minivosc_device *mydev = container_of(work, struct minivosc_device, fb_work);
+	struct sk_buff *skb;
+	void *hdr;
+	u32 fill, target = 0, period_us = 0;
+
+	// a snapshot of what the clock and the producers are updating; each
+	// value is read once, that is good enough for pacing
+	fill = minivosc_src_fill(mydev, &target);
+	if (mydev->pcm_bps)
+		period_us = div_u64((u64)mydev->pcm_period_size * USEC_PER_SEC, mydev->pcm_bps);
+
+	skb = genlmsg_new(NLMSG_GOODSIZE, GFP_KERNEL);
+	if (!skb)
+		return;
+
+	hdr = genlmsg_put(skb, 0, 0, &dc_genl_family, 0, DC_GENL_CMD_FEEDBACK);
+	if (!hdr)
+		goto EARLY_OUT;
+
+	if (nla_put_u32(skb, DC_GENL_ATTR_CARD, mydev->dev_id) ||
+	    nla_put_u32(skb, DC_GENL_ATTR_FB_FILL, fill) ||
+	    nla_put_u32(skb, DC_GENL_ATTR_FB_TARGET, target) ||
+	    nla_put_u32(skb, DC_GENL_ATTR_FB_DROPS, (u32)(mydev->jb.drops + mydev->jb.overruns)) ||
+	    nla_put_u32(skb, DC_GENL_ATTR_FB_UNDERRUNS, (u32)mydev->stats.underruns) ||
+	    nla_put_u32(skb, DC_GENL_ATTR_FB_LOST, (u32)mydev->stats.lost) ||
+	    nla_put_u32(skb, DC_GENL_ATTR_FB_DRIFT_PPM, (u32)mydev->drift.est_ppm) ||
+	    nla_put_u32(skb, DC_GENL_ATTR_FB_PERIOD_US, period_us))
+		goto EARLY_OUT;
+
+	genlmsg_end(skb, hdr);
+	// -ESRCH just means nobody listens
+	genlmsg_multicast(&dc_genl_family, skb, 0, DC_GENL_GRP_FEEDBACK, GFP_KERNEL);
+	return;
+
+EARLY_OUT:
+	nlmsg_free(skb);
 }
 
 
@@ -819,10 +2907,22 @@ static void minivosc_fill_capture_buf(struct minivosc_device *mydev, unsigned in
  *
  */
 // these should eventually get called by snd_card_free (via .dev_free)
-// however, since we do no special allocations, we need not free anything
+// the only things we allocate ourselves are the jitter buffer, the ring
+// and the playback staging frame
 static int minivosc_pcm_free(struct minivosc_device *chip)
 {
 	dbg("%s", __func__);
+	if (rcu_access_pointer(g_mydevs[chip->dev_id]) == chip) {
+		RCU_INIT_POINTER(g_mydevs[chip->dev_id], NULL);
+		// wait for netlink handlers still pushing into this card
+		synchronize_rcu();
+	}
+	cancel_work_sync(&chip->fb_work);
+	minivosc_pb_free(&chip->pb);
+	minivosc_ring_free(&chip->ring);
+	minivosc_jb_free(&chip->jb);
+	vfree(chip->shadow);
+	vfree(chip->pp_coef);
 	return 0;
 }
 
@@ -856,6 +2956,12 @@ static int __init alsa_card_minivosc_init(void)
 	int i, err, cards;
 
 	dbg("%s", __func__);
+
+	// geometry limits, MAX_BUFFER is preallocated per card
+	period_ms_min = clamp(period_ms_min, 1, 1000);
+	buffer_ms_max = clamp(buffer_ms_max, 2 * period_ms_min, 10000);
+	period_ms_max = clamp(period_ms_max, period_ms_min, buffer_ms_max / 2);
+
 	err = dc_netlink_init();
 	if (err != 0)
 		return -EEXIST;
@@ -0,0 +1,63 @@
+/*
+ * Generates minivosc-pp-table.h, the prototype lowpass filters of the
+ * polyphase resampler (minivosc-dsp.c). Build and run with "make pptables".
+ *
+ * Each table is a Kaiser windowed sinc over 'taps' input samples,
+ * oversampled MINIVOSC_PP_OS times, Q15.
+ */
+#include <stdio.h>
+#include <math.h>
+
+#include "minivosc-dsp.h"
+
+static const struct {
+	unsigned int taps;
+	double cutoff;	/* of the input Nyquist frequency */
+	double beta;	/* Kaiser window */
+} quality[] = {
+	{  8, 0.80, 5.0 },
+	{ 16, 0.88, 7.0 },
+	{ 32, 0.92, 9.0 },
+};
+
+// zeroth order modified Bessel function of the first kind
+static double bessel_i0(double x)
+{
+	double sum = 1, term = 1;
+	int k;
+
+	for (k = 1; k < 50; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+int main(void)
+{
+	unsigned int q, j;
+
+	printf("/* generated by pp-table-gen.c (make pptables), do not edit */\n");
+	for (q = 0; q < sizeof(quality) / sizeof(quality[0]); q++) {
+		unsigned int taps = quality[q].taps, len = taps * MINIVOSC_PP_OS + 1;
+		double rho = quality[q].cutoff, beta = quality[q].beta;
+
+		printf("\n/* quality %u: %u taps, cutoff %.2f, beta %.1f */\n", q, taps, rho, beta);
+		printf("static const s16 minivosc_pp_h%u[%u] = {", q, len);
+		for (j = 0; j < len; j++) {
+			double t = (double)j / MINIVOSC_PP_OS - taps / 2.0;
+			double x = t / (taps / 2.0);
+			double sinc = t == 0 ? 1 : sin(M_PI * rho * t) / (M_PI * rho * t);
+			double w = bessel_i0(beta * sqrt(x * x < 1 ? 1 - x * x : 0)) / bessel_i0(beta);
+
+			printf("%s%6ld,", j % 10 ? " " : "\n\t", lround(rho * sinc * w * 32768));
+		}
+		printf("\n};\n");
+	}
+
+	printf("\nstatic const struct {\n\tunsigned int taps;\n\tconst s16 *h;\n} minivosc_pp_tables[] = {\n");
+	for (q = 0; q < sizeof(quality) / sizeof(quality[0]); q++)
+		printf("\t{ %2u, minivosc_pp_h%u },\n", quality[q].taps, q);
+	printf("};\n");
+	return 0;
+}